@@ -0,0 +1,131 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : FalLog.h
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : Compile-time levelled logging and binary trace ring buffer for the FAL
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : nucleo_f401re
+ * @compiler : gcc-arm-none-eabi
+ *
+ **************************************************************************************************
+ *
+ */
+
+ #ifndef FAL_LOG_H
+ #define FAL_LOG_H
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Includes                                                                                      */
+ /*-----------------------------------------------------------------------------------------------*/
+ #include <stdint.h>
+ #include <stddef.h>
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Defines                                                                                       */
+ /*-----------------------------------------------------------------------------------------------*/
+ #define FAL_LOG_LEVEL_NONE    (0)
+ #define FAL_LOG_LEVEL_ERROR   (1)
+ #define FAL_LOG_LEVEL_WARN    (2)
+ #define FAL_LOG_LEVEL_INFO    (3)
+ #define FAL_LOG_LEVEL_DEBUG   (4)
+
+ /* Highest level compiled in, everything above expands to nothing (override with -D) */
+ #ifndef FAL_LOG_LEVEL
+   #define FAL_LOG_LEVEL FAL_LOG_LEVEL_WARN
+ #endif
+
+ /* Binary trace of hot-path events, drained from loop() (override with -D) */
+ #ifndef FAL_TRACE_ENABLED
+   #define FAL_TRACE_ENABLED (1)
+ #endif
+
+ /* Number of records in the trace ring buffer, must be a power of two */
+ #ifndef FAL_TRACE_DEPTH
+   #define FAL_TRACE_DEPTH (64U)
+ #endif
+
+ #if (FAL_TRACE_DEPTH & (FAL_TRACE_DEPTH - 1U)) != 0
+   #error "FAL_TRACE_DEPTH must be a power of two"
+ #endif
+
+ #if FAL_LOG_LEVEL >= FAL_LOG_LEVEL_ERROR
+   #define FAL_LOG_ERROR(...) FalLog::print(FAL_LOG_LEVEL_ERROR, __VA_ARGS__)
+ #else
+   #define FAL_LOG_ERROR(...) do {} while (0)
+ #endif
+
+ #if FAL_LOG_LEVEL >= FAL_LOG_LEVEL_WARN
+   #define FAL_LOG_WARN(...) FalLog::print(FAL_LOG_LEVEL_WARN, __VA_ARGS__)
+ #else
+   #define FAL_LOG_WARN(...) do {} while (0)
+ #endif
+
+ #if FAL_LOG_LEVEL >= FAL_LOG_LEVEL_INFO
+   #define FAL_LOG_INFO(...) FalLog::print(FAL_LOG_LEVEL_INFO, __VA_ARGS__)
+ #else
+   #define FAL_LOG_INFO(...) do {} while (0)
+ #endif
+
+ #if FAL_LOG_LEVEL >= FAL_LOG_LEVEL_DEBUG
+   #define FAL_LOG_DEBUG(...) FalLog::print(FAL_LOG_LEVEL_DEBUG, __VA_ARGS__)
+ #else
+   #define FAL_LOG_DEBUG(...) do {} while (0)
+ #endif
+
+ #if FAL_TRACE_ENABLED
+   #define FAL_TRACE(event, arg0, arg1) FalTrace::record((event), (uint32_t)(arg0), (uint32_t)(arg1))
+ #else
+   #define FAL_TRACE(event, arg0, arg1) do {} while (0)
+ #endif
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Types                                                                                         */
+ /*-----------------------------------------------------------------------------------------------*/
+ enum FalTraceEvent : uint16_t {
+   FAL_TRACE_ERASE = 1,        // arg0 = offset, arg1 = size
+   FAL_TRACE_WRITE,            // arg0 = offset, arg1 = size
+   FAL_TRACE_READ,             // arg0 = offset, arg1 = size
+   FAL_TRACE_SECTOR_LOOKUP,    // arg0 = address, arg1 = sector
+   FAL_TRACE_ERROR,            // arg0 = address or offset, arg1 = HAL error code
+   FAL_TRACE_ERASE_DONE,       // arg0 = 0, arg1 = result of an asynchronous erase
+ };
+
+ struct FalTraceRecord {
+   uint32_t timestamp;         // micros() when the event was recorded
+   uint16_t event;             // FalTraceEvent
+   uint16_t sequence;          // Free-running record number, gaps mean dropped records
+   uint32_t arg0;
+   uint32_t arg1;
+ };
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Classes                                                                                       */
+ /*-----------------------------------------------------------------------------------------------*/
+ class FalLog {
+ public:
+   // Formatted, blocking output of one log line. Use the FAL_LOG_* macros instead.
+   static void print(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+ };
+
+ class FalTrace {
+ public:
+   // Append a record, overwriting the oldest one when full. Safe from interrupts.
+   static void record(uint16_t event, uint32_t arg0, uint32_t arg1);
+
+   // Pop up to max records in chronological order, returns the number copied
+   static size_t read(FalTraceRecord *out, size_t max);
+
+   // Pop every pending record and print it as text, returns the number printed
+   static size_t drain(void);
+
+   // Number of records lost to overwriting since the last call
+   static uint32_t dropped(void);
+ };
+
+ #endif // FAL_LOG_H
@@ -0,0 +1,132 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : FalStats.h
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : I/O statistics of a Flash Abstraction Layer: bytes, operations, errors, latency
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : nucleo_f401re
+ * @compiler : gcc-arm-none-eabi
+ *
+ **************************************************************************************************
+ *
+ * Latencies are measured in DWT cycle counter ticks, divide by FalStats::cyclesPerMicrosecond
+ * for microseconds. The counter wraps after 2^32 cycles (51 s at 84 MHz), far longer than any
+ * single flash operation.
+ *
+ */
+
+ #ifndef FAL_STATS_H
+ #define FAL_STATS_H
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Includes                                                                                      */
+ /*-----------------------------------------------------------------------------------------------*/
+ #include <stdint.h>
+ #include <stddef.h>
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Defines                                                                                       */
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Collect statistics, 0 compiles the recorder to nothing (override with -D) */
+ #ifndef FAL_STATS_ENABLED
+   #define FAL_STATS_ENABLED (1)
+ #endif
+
+ /* Largest number of region sectors with their own erase counter (override with -D) */
+ #ifndef FAL_STATS_MAX_SECTORS
+   #define FAL_STATS_MAX_SECTORS (24U)
+ #endif
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Types                                                                                         */
+ /*-----------------------------------------------------------------------------------------------*/
+ enum FalStatsOp : uint8_t {
+   FAL_STATS_READ,             // read() and readv() calls
+   FAL_STATS_WRITE,            // write() and writev() calls
+   FAL_STATS_ERASE,            // erase() and eraseAsync() calls, until the erase completes
+   FAL_STATS_SYNC,             // sync() calls
+   FAL_STATS_OP_COUNT
+ };
+
+ enum FalStatsError : uint8_t {
+   FAL_STATS_ERR_RANGE,        // Offset or size outside the region
+   FAL_STATS_ERR_BUSY,         // Operation refused while an erase was running
+   FAL_STATS_ERR_PROGRAM,      // Flash controller reported a program error
+   FAL_STATS_ERR_VERIFY,       // Programmed data did not read back
+   FAL_STATS_ERR_ERASE,        // Flash controller reported an erase error
+   FAL_STATS_ERR_NOT_BLANK,    // verify_flash_erased() found programmed bytes
+   FAL_STATS_ERR_COUNT
+ };
+
+ struct FalLatency {
+   uint32_t count;             // Completed operations
+   uint32_t min;               // Cycles, UINT32_MAX while count is 0
+   uint32_t max;               // Cycles
+   uint64_t total;             // Cycles
+
+   uint32_t average(void) const { return (count != 0U) ? (uint32_t)(total / count) : 0U; }
+ };
+
+ struct FalStats {
+   uint64_t bytesRead;                           // Bytes returned by successful reads
+   uint64_t bytesProgrammed;                     // Bytes programmed into flash, after write-back merging
+   uint64_t bytesErased;                         // Bytes of sectors that went through an erase cycle
+   uint32_t errors[FAL_STATS_ERR_COUNT];         // Failures by cause
+   FalLatency latency[FAL_STATS_OP_COUNT];       // Successful operations by type
+   uint32_t sectorErases[FAL_STATS_MAX_SECTORS]; // Erase cycles per sector, from the first region sector
+   uint32_t sectorCount;                         // Valid entries of sectorErases
+   uint32_t cyclesPerMicrosecond;                // Divisor turning latency cycles into microseconds
+ };
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Classes                                                                                       */
+ /*-----------------------------------------------------------------------------------------------*/
+ // Counters owned by a FAL implementation. Every method is safe from interrupts.
+ class FalStatsRecorder {
+ public:
+   // Current cycle count, enables the DWT counter on first use
+   static uint32_t cycles(void);
+   // Rate of cycles(), for converting latencies to microseconds
+   static uint32_t cyclesPerMicrosecond(void);
+
+ #if FAL_STATS_ENABLED
+   // Constructor, sectorCount is the number of sectors in the region
+   explicit FalStatsRecorder(uint32_t sectorCount);
+
+   // Record a successful operation that started at cycles() == start, or took elapsed cycles
+   void complete(FalStatsOp op, uint32_t start);
+   void sample(FalStatsOp op, uint32_t elapsed);
+   void read(size_t bytes);
+   void programmed(size_t bytes);
+   void erased(uint32_t sector, size_t bytes);
+   void error(FalStatsError cause);
+
+   // Copy the counters, or clear them keeping the sector count
+   void snapshot(FalStats *out) const;
+   void reset(void);
+
+ private:
+   FalStats stats_;
+ #else
+   // Compiled out: no storage, every counter is an inline no-op and snapshots are zero
+   explicit FalStatsRecorder(uint32_t sectorCount) { (void)sectorCount; }
+
+   void complete(FalStatsOp op, uint32_t start) { (void)op; (void)start; }
+   void sample(FalStatsOp op, uint32_t elapsed) { (void)op; (void)elapsed; }
+   void read(size_t bytes) { (void)bytes; }
+   void programmed(size_t bytes) { (void)bytes; }
+   void erased(uint32_t sector, size_t bytes) { (void)sector; (void)bytes; }
+   void error(FalStatsError cause) { (void)cause; }
+
+   void snapshot(FalStats *out) const { *out = FalStats(); }
+   void reset(void) {}
+ #endif
+ };
+
+ #endif // FAL_STATS_H
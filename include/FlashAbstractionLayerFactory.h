@@ -23,15 +23,67 @@
  /*-----------------------------------------------------------------------------------------------*/
  /* Includes                                                                                      */
  /*-----------------------------------------------------------------------------------------------*/
- #include <Arduino.h>
+ #if defined(ARDUINO)
+   #include <Arduino.h>
+ #endif
+ #include <lfs.h>
  #include "IFlashAbstractionLayer.h"
- 
+ #if defined(STM32F4xx)
+   #include "STM32F4FlashAbstractionLayer.h"
+   #include "STM32F4DualBankFlashAbstractionLayer.h"
+ #elif !defined(ARDUINO)
+   #include "SimulatedFlashAbstractionLayer.h"
+ #endif
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Defines                                                                                       */
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Layer created for a part fixed at build time, undefined when the part is detected at runtime */
+ #if defined(STM32F4xx) && !FAL_FLASH_RUNTIME_DETECT
+   #if FAL_FLASH_DUAL_BANK
+     #define FAL_DEFAULT_TYPE STM32F4DualBankFlashAbstractionLayer<FAL_FLASH_PART>
+   #else
+     #define FAL_DEFAULT_TYPE STM32F4FlashAbstractionLayer<FAL_FLASH_PART>
+   #endif
+ #elif !defined(STM32F4xx) && !defined(ARDUINO)
+   #define FAL_DEFAULT_TYPE SimulatedFlashAbstractionLayer<FAL_FLASH_PART>
+ #endif
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Types                                                                                         */
+ /*-----------------------------------------------------------------------------------------------*/
+ struct FlashGeometry {
+   uint32_t deviceId;      // DEV_ID field of DBGMCU_IDCODE
+   uint32_t flashSize;     // Bytes, from the flash size register
+   uint32_t regionBase;    // Absolute address of the LittleFS region
+   uint32_t sectorSize;    // Erase unit of the region in bytes
+   uint32_t sectorCount;   // Sectors in the region
+   uint32_t blockSize;     // Logical block size for the translation layer and LittleFS
+ };
+
+ // Type behind the pointer createFlashAbstractionLayer() returns, cast to it to bind the upper
+ // layers statically. Only the interface is known when the part is detected at runtime.
+ #if defined(FAL_DEFAULT_TYPE)
+   typedef FAL_DEFAULT_TYPE FalDefaultLayer;
+ #else
+   typedef IFlashAbstractionLayer FalDefaultLayer;
+ #endif
+
  /*-----------------------------------------------------------------------------------------------*/
  /* Classes                                                                                       */
  /*-----------------------------------------------------------------------------------------------*/
  class FlashAbstractionLayerFactory {
  public:
    static IFlashAbstractionLayer* createFlashAbstractionLayer(void);
+
+   // Detect the part and pick the largest region clear of the firmware image, nullptr if the
+   // part is unknown or no region is safe. geometry is filled in either case. Host builds get
+   // the SimulatedFlashAbstractionLayer of FAL_FLASH_PART.
+   static IFlashAbstractionLayer* createFlashAbstractionLayer(FlashGeometry *geometry);
+
+   // Fill the geometry dependent fields of cfg: read_size, prog_size, block_size, cache_size
+   // and lookahead_size. Callbacks, block_count and block_cycles are left to the caller.
+   static void tuneConfig(const FlashGeometry *geometry, struct lfs_config *cfg);
  };
  
  #endif // FLASH_ABSTRACTION_LAYER_FACTORY_H
\ No newline at end of file
@@ -0,0 +1,50 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : FlashBlankCheck.h
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : Word-wide blank check of memory-mapped flash
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : nucleo_f401re
+ * @compiler : gcc-arm-none-eabi
+ *
+ **************************************************************************************************
+ *
+ */
+
+ #ifndef FLASH_BLANK_CHECK_H
+ #define FLASH_BLANK_CHECK_H
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Includes                                                                                      */
+ /*-----------------------------------------------------------------------------------------------*/
+ #include <stdint.h>
+ #include <stddef.h>
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Types                                                                                         */
+ /*-----------------------------------------------------------------------------------------------*/
+ struct FlashBlankCheckResult {
+   size_t firstDirty;      // Offset of the first byte that is not 0xFF, size if the range is blank
+   uint32_t dirtyWords;    // Number of 32-bit words holding at least one programmed byte
+ };
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Classes                                                                                       */
+ /*-----------------------------------------------------------------------------------------------*/
+ class FlashBlankCheck {
+ public:
+   // Scan a range for bytes other than 0xFF. With stopAtFirst the scan ends at the first dirty
+   // word and dirtyWords is at most 1. result may be nullptr. Returns true if the range is blank.
+   static bool scan(const void *addr, size_t size, bool stopAtFirst, FlashBlankCheckResult *result);
+
+   // Shorthand for scan(addr, size, true, nullptr)
+   static bool isBlank(const void *addr, size_t size) { return scan(addr, size, true, nullptr); }
+ };
+
+ #endif // FLASH_BLANK_CHECK_H
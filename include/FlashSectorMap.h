@@ -0,0 +1,79 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : FlashSectorMap.h
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : Constexpr flash sector descriptor tables and lookups
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : nucleo_f401re
+ * @compiler : gcc-arm-none-eabi
+ *
+ **************************************************************************************************
+ *
+ */
+
+ #ifndef FLASH_SECTOR_MAP_H
+ #define FLASH_SECTOR_MAP_H
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Includes                                                                                      */
+ /*-----------------------------------------------------------------------------------------------*/
+ #include <stdint.h>
+ #include <stddef.h>
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Types                                                                                         */
+ /*-----------------------------------------------------------------------------------------------*/
+ struct FlashSectorDescriptor {
+   uint32_t base;    // Absolute address of the first byte
+   uint32_t size;    // Size in bytes
+   uint32_t id;      // Sector number as expected by HAL_FLASHEx_Erase
+ };
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Functions                                                                                     */
+ /*-----------------------------------------------------------------------------------------------*/
+ /**
+  * @brief Binary search for the sector containing an address
+  * @param table Sector descriptors sorted by base address, without gaps
+  * @param count Number of descriptors
+  * @param addr Absolute address in flash
+  * @return Index into table, or -1 if the address is outside the table
+  */
+ constexpr int32_t flashSectorIndex(const FlashSectorDescriptor *table, size_t count, uint32_t addr) {
+   if (count == 0 || addr < table[0].base || addr - table[0].base >= table[count - 1].base + table[count - 1].size - table[0].base) {
+     return -1;
+   }
+   size_t lo = 0, hi = count - 1;
+   while (lo < hi) {
+     size_t mid = (lo + hi + 1) / 2;
+     if (table[mid].base <= addr) {
+       lo = mid;
+     } else {
+       hi = mid - 1;
+     }
+   }
+   return (int32_t)lo;
+ }
+
+ /**
+  * @brief Check that a table is sorted and contiguous, for use in static_assert
+  * @param table Sector descriptors
+  * @param count Number of descriptors
+  * @return True if every sector starts where the previous one ends
+  */
+ constexpr bool flashSectorMapIsContiguous(const FlashSectorDescriptor *table, size_t count) {
+   for (size_t i = 1; i < count; i++) {
+     if (table[i].base != table[i - 1].base + table[i - 1].size) {
+       return false;
+     }
+   }
+   return true;
+ }
+
+ #endif // FLASH_SECTOR_MAP_H
@@ -0,0 +1,128 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : FlashTranslationLayer.h
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : Logical-block translation layer mapping small LittleFS blocks onto large sectors
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : nucleo_f401re
+ * @compiler : gcc-arm-none-eabi
+ *
+ **************************************************************************************************
+ *
+ * Each physical sector is split into slots of one logical block. Slot 0 holds a sector header
+ * and one 32-bit tag per data slot, the remaining slots hold block data:
+ *
+ *   +--------+-----+-----+-----+--------+--------+-----+
+ *   | header | tag | tag | ... | slot 1 | slot 2 | ... |
+ *   +--------+-----+-----+-----+--------+--------+-----+
+ *   |<------ slot 0 ------>|
+ *
+ * Erasing a logical block allocates the next free slot of the newest sector and records the
+ * mapping in its tag, so the tags are the persistent mapping table. Slots are allocated in
+ * order and sectors carry an increasing sequence number, so on mount the last tag seen for a
+ * logical block wins. One sector is always kept erased so the garbage collector can move the
+ * live slots of the emptiest sector into it before erasing that sector.
+ *
+ * The layer is a template over the type of the layer below it. With a concrete type whose I/O
+ * methods are final, such as FalDefaultLayer of a part fixed at build time, the calls into it
+ * are direct. FlashTranslationLayer<> goes through the IFlashAbstractionLayer vtable instead.
+ *
+ */
+
+ #ifndef FLASH_TRANSLATION_LAYER_H
+ #define FLASH_TRANSLATION_LAYER_H
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Includes                                                                                      */
+ /*-----------------------------------------------------------------------------------------------*/
+ #include "IFlashAbstractionLayer.h"
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Defines                                                                                       */
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Largest number of physical sectors the layer can manage */
+ #ifndef FTL_MAX_SECTORS
+   #define FTL_MAX_SECTORS (8U)
+ #endif
+
+ /* Slots per sector held back from the logical capacity to bound garbage collection work */
+ #ifndef FTL_RESERVED_SLOTS
+   #define FTL_RESERVED_SLOTS (8U)
+ #endif
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Classes                                                                                       */
+ /*-----------------------------------------------------------------------------------------------*/
+ template <typename Fal = IFlashAbstractionLayer>
+ class FlashTranslationLayer final : public IFlashAbstractionLayer {
+ public:
+   // Constructor and Destructor
+   FlashTranslationLayer(Fal *fal, uint32_t sectorSize, uint32_t sectorCount, uint32_t blockSize);
+   ~FlashTranslationLayer() override;
+
+   // Rebuild the mapping from flash, repairing interrupted garbage collection
+   int mount(void);
+   // Erase every sector, dropping all logical blocks
+   int format(void);
+
+   // Logical geometry to use in lfs_config
+   uint32_t blockSize(void) const { return blockSize_; }
+   uint32_t logicalBlockCount(void) const { return logicalBlocks_; }
+
+   // Smallest power-of-two block size whose slot 0 can hold the tags of a sector
+   static uint32_t minimumBlockSize(uint32_t sectorSize);
+
+   // Override interface methods, offsets are logical (block * blockSize + off)
+   int erase(long offset, size_t size) override;
+   int write(long offset, const uint8_t *buf, size_t size) override;
+   int read(long offset, uint8_t *buf, size_t size) override;
+   int sync() override;
+   int readv(const FlashIoSegment *segs, size_t count) override;
+   int writev(const FlashIoSegment *segs, size_t count) override;
+   bool verify_flash_erased(uint32_t addr, size_t size) override;
+   const uint8_t *map(long offset, size_t size) override;
+   bool getStats(FalStats *out) const override;
+   void resetStats() override;
+
+ private:
+   struct SectorState {
+     uint32_t sequence;     // 0 when the sector is erased
+     uint16_t nextSlot;     // First unused data slot
+     uint16_t liveSlots;    // Data slots currently referenced by the map
+   };
+
+   // Private methods
+   int scanSector(uint32_t sector);
+   int eraseSector(uint32_t sector);
+   int openSector(uint32_t sector);
+   int allocateSlot(uint16_t lbn, uint16_t *slot);
+   int collectGarbage(void);
+   int relocateSector(uint32_t victim, uint32_t target);
+   int copySlot(uint16_t from, uint16_t to);
+   int writeTag(uint16_t slot, uint16_t lbn);
+   int isRangeErased(long offset, uint32_t size, bool *blank);
+   bool validRange(long offset, size_t size) const;
+   int findErasedSector(void) const;
+   int countErasedSectors(void) const;
+   long tagOffset(uint16_t slot) const;
+   long slotOffset(uint16_t slot) const;
+
+   Fal *fal_;
+   uint32_t sectorSize_;
+   uint32_t sectorCount_;
+   uint32_t blockSize_;
+   uint32_t slotsPerSector_;
+   uint32_t logicalBlocks_;
+   uint32_t sequence_;
+   int32_t activeSector_;
+   uint16_t *map_;
+   SectorState sectors_[FTL_MAX_SECTORS];
+ };
+
+ #endif // FLASH_TRANSLATION_LAYER_H
@@ -23,7 +23,32 @@
 /*-----------------------------------------------------------------------------------------------*/
  /* Includes                                                                                      */
  /*-----------------------------------------------------------------------------------------------*/
- #include <Arduino.h>
+ #if defined(ARDUINO)
+   #include <Arduino.h>
+ #else
+   #include <stdint.h>
+   #include <stddef.h>
+ #endif
+ #include "FalStats.h"
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Defines                                                                                       */
+ /*-----------------------------------------------------------------------------------------------*/
+ #define FAL_BUSY        (1)     // pollErase(): an asynchronous erase is still running
+ #define FAL_ERR_CORRUPT (-84)   // Programmed data failed verification, same value as LFS_ERR_CORRUPT
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Types                                                                                         */
+ /*-----------------------------------------------------------------------------------------------*/
+ // Completion of an asynchronous operation, result is 0 or a negative error code
+ typedef void (*FalCompletionCallback)(void *ctx, int result);
+
+ // One range of a readv()/writev() batch
+ struct FlashIoSegment {
+   long offset;      // Offset relative to the layer's region
+   void *data;       // Destination for readv(), source for writev()
+   size_t size;      // Number of bytes
+ };
 
  /*-----------------------------------------------------------------------------------------------*/
  /* Classes                                                                                       */
@@ -39,6 +64,52 @@
    virtual int read(long offset, uint8_t *buf, size_t size) = 0;
    virtual int sync() = 0;
    virtual bool verify_flash_erased(uint32_t addr, size_t size) = 0;
+
+   // Batched read()/write(), return the total byte count or the first negative error code.
+   // Implementations can share setup such as unlocking flash across the whole batch.
+   virtual int readv(const FlashIoSegment *segs, size_t count) {
+     int total = 0;
+     for (size_t i = 0; i < count; i++) {
+       int result = read(segs[i].offset, (uint8_t *)segs[i].data, segs[i].size);
+       if (result < 0) {
+         return result;
+       }
+       total += result;
+     }
+     return total;
+   }
+   virtual int writev(const FlashIoSegment *segs, size_t count) {
+     int total = 0;
+     for (size_t i = 0; i < count; i++) {
+       int result = write(segs[i].offset, (const uint8_t *)segs[i].data, segs[i].size);
+       if (result < 0) {
+         return result;
+       }
+       total += result;
+     }
+     return total;
+   }
+
+   // Direct pointer to a range of memory-mapped flash, nullptr if not mappable
+   virtual const uint8_t *map(long offset, size_t size) { (void)offset; (void)size; return nullptr; }
+
+   // Start an erase and return immediately, cb runs on completion (possibly from an interrupt).
+   // The default implementation erases synchronously.
+   virtual int eraseAsync(long offset, size_t size, FalCompletionCallback cb, void *ctx) {
+     int result = erase(offset, size);
+     if (cb != nullptr) {
+       cb(ctx, (result < 0) ? result : 0);
+     }
+     return (result < 0) ? result : 0;
+   }
+   // FAL_BUSY while an asynchronous erase runs, then its result
+   virtual int pollErase() { return 0; }
+   // Called repeatedly while erase() waits, so the application keeps running
+   virtual void setIdleHook(void (*hook)(void)) { (void)hook; }
+
+   // Copy the I/O statistics gathered since the last resetStats(), false if none are kept
+   virtual bool getStats(FalStats *out) const { (void)out; return false; }
+   virtual void resetStats() {}
  };
  
  #endif // IFLASH_ABSTRACTION_LAYER_H
\ No newline at end of file
@@ -0,0 +1,56 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : LfsDirectAccess.h
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : Zero-copy access to LittleFS file contents in memory-mapped flash
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : nucleo_f401re
+ * @compiler : gcc-arm-none-eabi
+ *
+ **************************************************************************************************
+ *
+ */
+
+ #ifndef LFS_DIRECT_ACCESS_H
+ #define LFS_DIRECT_ACCESS_H
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Includes                                                                                      */
+ /*-----------------------------------------------------------------------------------------------*/
+ #include <lfs.h>
+ #include "IFlashAbstractionLayer.h"
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Types                                                                                         */
+ /*-----------------------------------------------------------------------------------------------*/
+ struct FlashSpan {
+   lfs_off_t pos;           // File position of data[0]
+   const uint8_t *data;     // Direct pointer into flash, valid only inside the span callback
+   lfs_size_t size;         // Number of contiguous bytes at data
+ };
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Classes                                                                                       */
+ /*-----------------------------------------------------------------------------------------------*/
+ class LfsDirectAccess {
+ public:
+   // Return non-zero to stop the walk, the value is passed back to the caller
+   typedef int (*SpanCallback)(void *ctx, const FlashSpan &span);
+
+   // Walk an open file as one span per data block, last block first. fal must be the layer
+   // behind the lfs_config callbacks. Inlined files and unmappable layers return LFS_ERR_INVAL.
+   // Any write or erase on the filesystem may move blocks (the FTL garbage collector relocates
+   // slots of unrelated files too), so a span must not be kept past its callback. With
+   // LFS_THREADSAFE the filesystem lock is held for the whole walk, which keeps other tasks
+   // from writing meanwhile; cb must therefore not call back into lfs.
+   static int forEachSpan(lfs_t *lfs, lfs_file_t *file, IFlashAbstractionLayer *fal,
+                          SpanCallback cb, void *ctx);
+ };
+
+ #endif // LFS_DIRECT_ACCESS_H
@@ -0,0 +1,90 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : LfsFalBinding.h
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : Statically bound lfs_config callbacks for a concrete Flash Abstraction Layer
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : nucleo_f401re
+ * @compiler : gcc-arm-none-eabi
+ *
+ **************************************************************************************************
+ *
+ * LfsFalBinding<Fal>::bind() stores the layer in lfs_config::context and points the callbacks
+ * at functions that call Fal's methods by qualified name, so the compiler emits direct calls
+ * (usually inlined) instead of going through the vtable. The layers below Fal are reached the
+ * same way only when their types are concrete too: bind a FlashTranslationLayer over
+ * FalDefaultLayer, a FlashTranslationLayer<> still calls the FAL through its vtable. Each
+ * lfs_config carries its own layer, so several filesystems can run side by side:
+ *
+ *   struct lfs_config cfg = {};
+ *   LfsFalBinding<FlashTranslationLayer<FalDefaultLayer>>::bind(&ftl, &cfg);
+ *   cfg.block_size = ...;
+ *
+ */
+
+ #ifndef LFS_FAL_BINDING_H
+ #define LFS_FAL_BINDING_H
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Includes                                                                                      */
+ /*-----------------------------------------------------------------------------------------------*/
+ #include <lfs.h>
+ #include "IFlashAbstractionLayer.h"
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Classes                                                                                       */
+ /*-----------------------------------------------------------------------------------------------*/
+ template <typename Fal>
+ class LfsFalBinding {
+ public:
+   // Set context and the read/prog/erase/sync callbacks of cfg, other fields are left alone
+   static void bind(Fal *fal, struct lfs_config *cfg) {
+     cfg->context = fal;
+     cfg->read = read;
+     cfg->prog = prog;
+     cfg->erase = erase;
+     cfg->sync = sync;
+   }
+
+   static int read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size) {
+     int result = layer(c)->Fal::read(offset(c, block, off), (uint8_t *)buffer, size);
+     return (result == (int)size) ? 0 : toLfsError(result);
+   }
+
+   static int prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size) {
+     int result = layer(c)->Fal::write(offset(c, block, off), (const uint8_t *)buffer, size);
+     return (result == (int)size) ? 0 : toLfsError(result);
+   }
+
+   static int erase(const struct lfs_config *c, lfs_block_t block) {
+     int result = layer(c)->Fal::erase(offset(c, block, 0), c->block_size);
+     return (result >= 0) ? 0 : toLfsError(result);
+   }
+
+   static int sync(const struct lfs_config *c) {
+     int result = layer(c)->Fal::sync();
+     return (result == 0) ? 0 : toLfsError(result);
+   }
+
+ private:
+   static Fal *layer(const struct lfs_config *c) {
+     return static_cast<Fal *>(c->context);
+   }
+
+   static long offset(const struct lfs_config *c, lfs_block_t block, lfs_off_t off) {
+     return (long)block * (long)c->block_size + (long)off;
+   }
+
+   // FAL_ERR_CORRUPT lets LittleFS relocate the block, anything else is an I/O error
+   static int toLfsError(int result) {
+     return (result == FAL_ERR_CORRUPT) ? LFS_ERR_CORRUPT : LFS_ERR_IO;
+   }
+ };
+
+ #endif // LFS_FAL_BINDING_H
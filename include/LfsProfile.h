@@ -0,0 +1,74 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : LfsProfile.h
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : Cycle counter and CSV/binary dump of the LittleFS latency profile
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : nucleo_f401re
+ * @compiler : gcc-arm-none-eabi
+ *
+ **************************************************************************************************
+ *
+ * Build with -DLFS_PROFILE to make every public lfs_* call record its latency in a log2
+ * histogram, split into the time spent in lfs_dir_compact, lfs_alloc_scan, lfs_bd_erase and
+ * lfs_bd_flush. Latencies are DWT cycles. Only calls made at least once are dumped.
+ *
+ * CSV has one row per call:
+ *
+ *   call,count,total,max,dir_compact_n,dir_compact,...,bd_flush_n,bd_flush,h0,...,h31
+ *
+ * hK counts calls that took [2^K, 2^(K+1)) cycles. The binary format is little endian:
+ *
+ *   header  "LFSP" u8 version, u8 buckets, u8 phases, u8 records, u32 cycles per microsecond
+ *   record  u8 call, u32 count, u64 total, u32 max, phases x (u32 count, u64 cycles),
+ *           u8 first bucket, u8 bucket count, bucket count x u32
+ *
+ */
+
+ #ifndef LFS_PROFILE_H
+ #define LFS_PROFILE_H
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Includes                                                                                      */
+ /*-----------------------------------------------------------------------------------------------*/
+ #include <stdint.h>
+ #include <stddef.h>
+ #include <lfs.h>
+
+ #ifdef LFS_PROFILE
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Defines                                                                                       */
+ /*-----------------------------------------------------------------------------------------------*/
+ #define LFS_PROFILE_DUMP_VERSION (1U)   // First byte after the magic of the binary dump
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Types                                                                                         */
+ /*-----------------------------------------------------------------------------------------------*/
+ // Sink for dump output, nullptr selects Serial (stdout on the host)
+ typedef void (*LfsProfileWriter)(void *ctx, const uint8_t *data, size_t size);
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Classes                                                                                       */
+ /*-----------------------------------------------------------------------------------------------*/
+ class LfsProfile {
+ public:
+   // Write the profile as CSV text with a header line, returns the number of rows
+   static size_t dumpCsv(LfsProfileWriter write = nullptr, void *ctx = nullptr);
+
+   // Write the profile in the binary format above, returns the number of bytes
+   static size_t dumpBinary(LfsProfileWriter write = nullptr, void *ctx = nullptr);
+
+   // Clear every histogram
+   static void reset(void) { lfs_profile_reset(); }
+ };
+
+ #endif // LFS_PROFILE
+
+ #endif // LFS_PROFILE_H
@@ -0,0 +1,141 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : LfsRtos.h
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : FreeRTOS locking hooks and flash service task for sharing LittleFS between tasks
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : nucleo_f401re
+ * @compiler : gcc-arm-none-eabi
+ *
+ **************************************************************************************************
+ *
+ * Two ways to share a filesystem between tasks, enabled with -DFAL_RTOS_ENABLED=1:
+ *
+ * - LfsRtos::bind() sets the LFS_THREADSAFE lock/unlock hooks of an lfs_config to one FreeRTOS
+ *   mutex. There is a single flash controller, so all filesystems share that mutex. It is a
+ *   priority-inheriting mutex, so a low priority task holding it through a long erase is raised
+ *   to the priority of the highest task waiting for it.
+ *
+ * - LfsService runs a task that owns the lfs_t and executes requests from a queue, so only one
+ *   task ever touches the filesystem and callers never hold a lock:
+ *
+ *     static int append(lfs_t *lfs, void *arg) { ... lfs_file_open(lfs, ...) ... }
+ *     LfsService service(&lfs);
+ *     service.start();
+ *     int err = service.call(append, &record);   // from any task
+ *
+ * Install LfsRtos::idleHook with IFlashAbstractionLayer::setIdleHook() so the task waiting for
+ * an erase sleeps instead of spinning, letting other tasks run while the sector is erased. This
+ * needs the region in a bank the firmware does not run from (the dual-bank FAL); on single-bank
+ * parts the hook is refused and every task stalls until the erase ends.
+ *
+ */
+
+ #ifndef LFS_RTOS_H
+ #define LFS_RTOS_H
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Defines                                                                                       */
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Build the FreeRTOS integration, needs the STM32duino FreeRTOS library (override with -D) */
+ #ifndef FAL_RTOS_ENABLED
+   #define FAL_RTOS_ENABLED (0)
+ #endif
+
+ #if FAL_RTOS_ENABLED
+
+ /* Pending requests the service queue can hold before call() blocks (override with -D) */
+ #ifndef LFS_SERVICE_QUEUE_DEPTH
+   #define LFS_SERVICE_QUEUE_DEPTH (8U)
+ #endif
+
+ /* Default stack of the service task in words, LittleFS recursion needs about 1 KB (override with -D) */
+ #ifndef LFS_SERVICE_STACK_WORDS
+   #define LFS_SERVICE_STACK_WORDS (512U)
+ #endif
+
+ /* Default priority of the service task (override with -D) */
+ #ifndef LFS_SERVICE_PRIORITY
+   #define LFS_SERVICE_PRIORITY (tskIDLE_PRIORITY + 2)
+ #endif
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Includes                                                                                      */
+ /*-----------------------------------------------------------------------------------------------*/
+ #if defined(ARDUINO)
+   #include <STM32FreeRTOS.h>
+ #else
+   #include <FreeRTOS.h>
+   #include <queue.h>
+   #include <semphr.h>
+   #include <task.h>
+ #endif
+ #include <lfs.h>
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Types                                                                                         */
+ /*-----------------------------------------------------------------------------------------------*/
+ // Work executed by the service task, returns 0 or a negative LittleFS error code
+ typedef int (*LfsServiceFn)(lfs_t *lfs, void *arg);
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Classes                                                                                       */
+ /*-----------------------------------------------------------------------------------------------*/
+ class LfsRtos {
+ public:
+   // Create the flash mutex, call once before the first lock. Returns 0 or LFS_ERR_NOMEM.
+   static int begin(void);
+
+ #if defined(LFS_THREADSAFE)
+   // Point the lock/unlock hooks of cfg at the flash mutex, other fields are left alone
+   static void bind(struct lfs_config *cfg);
+ #endif
+
+   // lfs_config lock/unlock hooks, also usable around direct FAL calls with cfg == nullptr
+   static int lock(const struct lfs_config *cfg);
+   static int unlock(const struct lfs_config *cfg);
+
+   // FAL idle hook: sleep one tick while flash is busy, or yield before the scheduler runs
+   static void idleHook(void);
+ };
+
+ class LfsService {
+ public:
+   // Constructor, lfs must stay valid while the service runs
+   explicit LfsService(lfs_t *lfs);
+
+   // Create the queue and the task. Returns 0 or LFS_ERR_NOMEM.
+   int start(UBaseType_t priority = LFS_SERVICE_PRIORITY, uint32_t stackWords = LFS_SERVICE_STACK_WORDS);
+
+   // Run fn(lfs, arg) in the service task and wait for its result. Runs fn directly when
+   // called from the service task itself or before the scheduler has started.
+   int call(LfsServiceFn fn, void *arg);
+
+   // Task that owns the filesystem, nullptr until start()
+   TaskHandle_t task(void) const { return task_; }
+
+ private:
+   struct Request {
+     LfsServiceFn fn;
+     void *arg;
+     TaskHandle_t caller;   // Notified when result is valid
+     int *result;
+   };
+
+   // Private methods
+   static void run(void *param);
+
+   lfs_t *lfs_;
+   QueueHandle_t queue_;
+   TaskHandle_t task_;
+ };
+
+ #endif // FAL_RTOS_ENABLED
+
+ #endif // LFS_RTOS_H
@@ -0,0 +1,64 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : STM32F4DualBankFlashAbstractionLayer.h
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : Read-while-write Flash Abstraction Layer for dual-bank STM32F42x/43x parts
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : nucleo_f429zi
+ * @compiler : gcc-arm-none-eabi
+ *
+ **************************************************************************************************
+ *
+ * The firmware runs from the first bank of the address map and the LittleFS region lies in the
+ * second one, so the CPU keeps fetching code and constants while the region is programmed or
+ * erased. Erases always run from the flash interrupt and waiting for them services every
+ * interrupt, not only FAL_RAMFUNC handlers. Reads of the region itself still wait for the erase.
+ *
+ * With the banks swapped (SYSCFG UFB_MODE) the addresses stay the same but decode to the other
+ * physical bank, which the sector numbers given to the controller are adjusted for.
+ *
+ */
+
+ #ifndef STM32F4_DUAL_BANK_FLASH_ABSTRACTION_LAYER_H
+ #define STM32F4_DUAL_BANK_FLASH_ABSTRACTION_LAYER_H
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Includes                                                                                      */
+ /*-----------------------------------------------------------------------------------------------*/
+ #include "STM32F4FlashAbstractionLayer.h"
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Classes                                                                                       */
+ /*-----------------------------------------------------------------------------------------------*/
+ template <typename Part>
+ class STM32F4DualBankFlashAbstractionLayer final : public STM32F4FlashAbstractionLayer<Part> {
+   static_assert(Part::bankCount == 2U && Part::sectorCount % 2U == 0U, "Part has no second bank");
+   static_assert(Part::firmwareSize <= Part::bankSize, "Firmware reservation must fit in the first bank");
+   static_assert(Part::regionBase >= Part::sectors[0].base + Part::bankSize,
+                 "LittleFS region must be in the second bank");
+
+ public:
+   // Constructor and Destructor
+   STM32F4DualBankFlashAbstractionLayer();
+   ~STM32F4DualBankFlashAbstractionLayer() override;
+
+   // Override interface methods
+   int erase(long offset, size_t size) override;
+
+   // True if the running firmware and the region are in different banks
+   bool readWhileWrite(void) const { return readWhileWrite_; }
+
+ private:
+   // Private methods
+   static uint32_t bankOf(uint32_t addr);
+
+   bool readWhileWrite_;
+ };
+
+ #endif // STM32F4_DUAL_BANK_FLASH_ABSTRACTION_LAYER_H
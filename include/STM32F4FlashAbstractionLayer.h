@@ -25,28 +25,164 @@
  /*-----------------------------------------------------------------------------------------------*/
  #include <Arduino.h>
  #include "IFlashAbstractionLayer.h"
+ #include "STM32F4FlashParts.h"
   
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Defines                                                                                       */
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Write verification used until setVerifyPolicy() is called (override with -D) */
+ #ifndef FAL_VERIFY_POLICY
+   #define FAL_VERIFY_POLICY FAL_VERIFY_CHUNK
+ #endif
+
+ /* Written ranges remembered for FAL_VERIFY_SYNC before an early verification is forced */
+ #ifndef FAL_VERIFY_PENDING_MAX
+   #define FAL_VERIFY_PENDING_MAX (8U)
+ #endif
+
+ /* Bytes of the RAM write-back window, 0 programs every write() immediately (override with -D) */
+ #ifndef FAL_WRITE_BACK_SIZE
+   #define FAL_WRITE_BACK_SIZE (0U)
+ #endif
+
+ #if (FAL_WRITE_BACK_SIZE & (FAL_WRITE_BACK_SIZE - 1U)) != 0 || (FAL_WRITE_BACK_SIZE > 0 && FAL_WRITE_BACK_SIZE < 8)
+   #error "FAL_WRITE_BACK_SIZE must be 0 or a power of two of at least 8"
+ #endif
+
+ /* Run the program and erase loops from SRAM so the CPU never fetches from a busy flash */
+ #ifndef FAL_RAMFUNC_ENABLED
+   #define FAL_RAMFUNC_ENABLED (1)
+ #endif
+
+ /* Places a function in the .RamFunc section, also usable on interrupt handlers that must keep
+    running while flash is busy (together with relocateVectorTable()) */
+ #if FAL_RAMFUNC_ENABLED && defined(__arm__)
+   #define FAL_RAMFUNC __attribute__((section(".RamFunc"), noinline, long_call))
+ #else
+   #define FAL_RAMFUNC
+ #endif
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Types                                                                                         */
+ /*-----------------------------------------------------------------------------------------------*/
+ enum FalVerifyPolicy {
+   FAL_VERIFY_NONE,      // Trust the HAL status only
+   FAL_VERIFY_CHUNK,     // Compare each programmed unit right after programming it
+   FAL_VERIFY_SYNC,      // Compare a CRC of every range written since the last sync() in sync()
+ };
+
  /*-----------------------------------------------------------------------------------------------*/
  /* Classes                                                                                       */
  /*-----------------------------------------------------------------------------------------------*/
+ template <typename Part>
  class STM32F4FlashAbstractionLayer : public IFlashAbstractionLayer {
+   static_assert(flashSectorMapIsContiguous(Part::sectors, Part::sectorCount), "Sector map has gaps");
+   static_assert(Part::sectors[Part::sectorCount - 1U].base + Part::sectors[Part::sectorCount - 1U].size - Part::sectors[0].base ==
+                 Part::bankCount * Part::bankSize, "Sector map does not match the bank layout");
+   static_assert(Part::programWidth == 1U || Part::programWidth == 2U || Part::programWidth == 4U || Part::programWidth == 8U,
+                 "Program width must be 1, 2, 4 or 8 bytes");
+   static_assert(Part::regionSize != 0U &&
+                 flashSectorIndex(Part::sectors, Part::sectorCount, Part::regionBase) >= 0 &&
+                 flashSectorIndex(Part::sectors, Part::sectorCount, Part::regionBase + Part::regionSize - 1U) >= 0,
+                 "LittleFS region is outside the sector map");
+   static_assert(Part::sectors[flashSectorIndex(Part::sectors, Part::sectorCount, Part::regionBase)].base == Part::regionBase,
+                 "LittleFS region must start on a sector boundary");
+   static_assert(Part::sectors[flashSectorIndex(Part::sectors, Part::sectorCount, Part::regionBase + Part::regionSize - 1U)].base +
+                 Part::sectors[flashSectorIndex(Part::sectors, Part::sectorCount, Part::regionBase + Part::regionSize - 1U)].size ==
+                 Part::regionBase + Part::regionSize, "LittleFS region must end on a sector boundary");
+   static_assert(Part::regionBase >= Part::sectors[0].base + Part::firmwareSize,
+                 "LittleFS region overlaps the firmware image");
+   static_assert(flashSectorIndex(Part::sectors, Part::sectorCount, Part::regionBase + Part::regionSize - 1U) -
+                 flashSectorIndex(Part::sectors, Part::sectorCount, Part::regionBase) < (int32_t)FAL_STATS_MAX_SECTORS,
+                 "Raise FAL_STATS_MAX_SECTORS to count erases of every region sector");
+   // True if the region lies in the bank the firmware starts in, where waiting in flash stalls
+   static constexpr bool regionInFirmwareBank = Part::regionBase - Part::sectors[0].base < Part::bankSize;
+
+   static_assert(FAL_WRITE_BACK_SIZE <= 16U * 1024U && FAL_WRITE_BACK_SIZE % Part::programWidth == 0U,
+                 "Write-back window must fit the smallest sector and hold whole program units");
+
  public:
    // Constructor and Destructor
    STM32F4FlashAbstractionLayer();
    ~STM32F4FlashAbstractionLayer() override;
  
-   // Override interface methods
+   // Override interface methods, final so calls through this type are direct. erase() stays
+   // virtual for the dual-bank layer.
    int erase(long offset, size_t size) override;
-   int write(long offset, const uint8_t *buf, size_t size) override;
-   int read(long offset, uint8_t *buf, size_t size) override;
-   int sync() override;
+   int write(long offset, const uint8_t *buf, size_t size) final;
+   int read(long offset, uint8_t *buf, size_t size) final;
+   int sync() final;
+   int readv(const FlashIoSegment *segs, size_t count) final;
+   int writev(const FlashIoSegment *segs, size_t count) final;
  
    // Additional methods
    bool verify_flash_erased(uint32_t addr, size_t size)override;
+   const uint8_t *map(long offset, size_t size) final;
+
+   // Interrupt-driven erase
+   int eraseAsync(long offset, size_t size, FalCompletionCallback cb, void *ctx) override;
+   int pollErase() override;
+   // Refused while the firmware runs from the region's bank, erase() then waits in SRAM
+   void setIdleHook(void (*hook)(void)) override;
+   int waitErase(void);
+
+   // Called from the flash interrupt when the asynchronous erase ends
+   void completeErase(int result);
+
+   // Select how programmed data is verified
+   void setVerifyPolicy(FalVerifyPolicy policy);
+
+   // I/O statistics, erase counts are indexed from the first sector of the region
+   bool getStats(FalStats *out) const override;
+   void resetStats() override;
+
+   // Copy the vector table to SRAM so FAL_RAMFUNC handlers are reached without flash fetches
+   static void relocateVectorTable(void);
  
+ protected:
+   // Added to the sector ids of the part, for banks that are mapped swapped
+   int32_t sectorIdOffset_;
+   // The firmware runs from the region's bank, no idle hook and no waiting in flash
+   bool sharedBank_;
+
  private:
    // Private methods
-   uint32_t getSectorFromOffset(uint32_t addr);
+   int prepareErase(long offset, size_t size, FLASH_EraseInitTypeDef *init);
+   int verifyPending(void);
+   int recordPending(uint32_t addr, const uint8_t *buf, size_t size);
+   int programSegments(const FlashIoSegment *segs, size_t count);
+   int loadWriteBack(uint32_t window);
+   int flushWriteBack(void);
+   static bool validRange(long offset, size_t size);
+   static void onEraseComplete(void *self, int result);
+
+   // First sector of the region in Part::sectors and the number of region sectors
+   static constexpr int32_t regionFirstIndex = flashSectorIndex(Part::sectors, Part::sectorCount, Part::regionBase);
+   static constexpr uint32_t regionSectors =
+       (uint32_t)(flashSectorIndex(Part::sectors, Part::sectorCount, Part::regionBase + Part::regionSize - 1U) - regionFirstIndex + 1);
+
+   volatile int eraseState_;
+   uint32_t eraseStart_;   // cycles() when the asynchronous erase started
+   FalCompletionCallback eraseCallback_;
+   void *eraseContext_;
+   void (*idleHook_)(void);
+
+   struct PendingVerify {
+     uint32_t addr;
+     uint32_t size;
+     uint32_t crc;
+   };
+   FalVerifyPolicy verifyPolicy_;
+   PendingVerify pending_[FAL_VERIFY_PENDING_MAX];
+   uint32_t pendingCount_;
+
+   // Write-back window: flash content of the window with the unprogrammed writes applied
+   int32_t wbWindow_;      // Region offset of the window, -1 if none is loaded
+   uint32_t wbLo_;         // Dirty bytes are [wbLo_, wbHi_) within the window
+   uint32_t wbHi_;
+   uint8_t wbData_[(FAL_WRITE_BACK_SIZE > 0U) ? FAL_WRITE_BACK_SIZE : 1U] __attribute__((aligned(8)));
+
+   FalStatsRecorder stats_;
  };
  
  #endif // STM32F4_FLASH_ABSTRACTION_LAYER_H
\ No newline at end of file
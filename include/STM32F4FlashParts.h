@@ -0,0 +1,221 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : STM32F4FlashParts.h
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : Constexpr flash geometry of the supported STM32F4 parts
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : nucleo_f401re
+ * @compiler : gcc-arm-none-eabi
+ *
+ **************************************************************************************************
+ *
+ * Every part is a struct of constants passed as template argument to STM32F4FlashAbstractionLayer:
+ *
+ *   sectors, sectorCount  Sector map sorted by address, see FlashSectorMap.h
+ *   bankCount, bankSize   Flash banks and the size of one bank in bytes
+ *   programWidth          Widest program unit in bytes, also selects the erase parallelism
+ *   firmwareSize          Bytes from the start of flash reserved for the firmware image
+ *   regionBase            Absolute address of the LittleFS region, on a sector boundary
+ *   regionSize            Size of the LittleFS region, a whole number of sectors
+ *   vectorCount           Entries of the vector table, core exceptions included
+ *   deviceId, flashSize   DEV_ID in DBGMCU_IDCODE and the flash size the map is valid for
+ *
+ * The ...Large variants trade firmware space for a bigger region, the factory picks them at
+ * runtime when the firmware image is small enough (FAL_FLASH_RUNTIME_DETECT).
+ */
+
+ #ifndef STM32F4_FLASH_PARTS_H
+ #define STM32F4_FLASH_PARTS_H
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Includes                                                                                      */
+ /*-----------------------------------------------------------------------------------------------*/
+ #if defined(ARDUINO)
+   #include <Arduino.h>
+ #endif
+ #include "FlashSectorMap.h"
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Defines                                                                                       */
+ /*-----------------------------------------------------------------------------------------------*/
+ /* HAL encoding of the voltage ranges, for host builds of the simulated flash */
+ #if !defined(ARDUINO) && !defined(FLASH_VOLTAGE_RANGE_1)
+   #define FLASH_VOLTAGE_RANGE_1 (0x00U)
+   #define FLASH_VOLTAGE_RANGE_2 (0x01U)
+   #define FLASH_VOLTAGE_RANGE_3 (0x02U)
+   #define FLASH_VOLTAGE_RANGE_4 (0x03U)
+ #endif
+
+ /* Supply voltage range used for erase and program parallelism (override with -D) */
+ #ifndef FAL_FLASH_VOLTAGE_RANGE
+   #define FAL_FLASH_VOLTAGE_RANGE FLASH_VOLTAGE_RANGE_3
+ #endif
+
+ /* Widest program unit allowed by the voltage range (RM0368 table 6) */
+ #if (FAL_FLASH_VOLTAGE_RANGE == FLASH_VOLTAGE_RANGE_4)
+   #define FAL_FLASH_PROGRAM_WIDTH (8U)                              // x64, requires external Vpp
+ #elif (FAL_FLASH_VOLTAGE_RANGE == FLASH_VOLTAGE_RANGE_3)
+   #define FAL_FLASH_PROGRAM_WIDTH (4U)                              // x32, 2.7 V - 3.6 V
+ #elif (FAL_FLASH_VOLTAGE_RANGE == FLASH_VOLTAGE_RANGE_2)
+   #define FAL_FLASH_PROGRAM_WIDTH (2U)                              // x16, 2.1 V - 2.7 V
+ #else
+   #define FAL_FLASH_PROGRAM_WIDTH (1U)                              // x8, 1.8 V - 2.1 V
+ #endif
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Sector Maps                                                                                   */
+ /*-----------------------------------------------------------------------------------------------*/
+ /* 512 KB single bank: STM32F401xE (RM0368), STM32F411xE (RM0383), STM32F446xE (RM0390) */
+ static constexpr FlashSectorDescriptor kSTM32F4Sectors512K[] = {
+   { 0x08000000U,  16U * 1024U,  0U },
+   { 0x08004000U,  16U * 1024U,  1U },
+   { 0x08008000U,  16U * 1024U,  2U },
+   { 0x0800C000U,  16U * 1024U,  3U },
+   { 0x08010000U,  64U * 1024U,  4U },
+   { 0x08020000U, 128U * 1024U,  5U },
+   { 0x08040000U, 128U * 1024U,  6U },
+   { 0x08060000U, 128U * 1024U,  7U },
+ };
+
+ /* 2 MB dual bank: STM32F429xI/STM32F439xI (RM0090 table 6) */
+ static constexpr FlashSectorDescriptor kSTM32F4Sectors2M[] = {
+   { 0x08000000U,  16U * 1024U,  0U },
+   { 0x08004000U,  16U * 1024U,  1U },
+   { 0x08008000U,  16U * 1024U,  2U },
+   { 0x0800C000U,  16U * 1024U,  3U },
+   { 0x08010000U,  64U * 1024U,  4U },
+   { 0x08020000U, 128U * 1024U,  5U },
+   { 0x08040000U, 128U * 1024U,  6U },
+   { 0x08060000U, 128U * 1024U,  7U },
+   { 0x08080000U, 128U * 1024U,  8U },
+   { 0x080A0000U, 128U * 1024U,  9U },
+   { 0x080C0000U, 128U * 1024U, 10U },
+   { 0x080E0000U, 128U * 1024U, 11U },
+   { 0x08100000U,  16U * 1024U, 12U },
+   { 0x08104000U,  16U * 1024U, 13U },
+   { 0x08108000U,  16U * 1024U, 14U },
+   { 0x0810C000U,  16U * 1024U, 15U },
+   { 0x08110000U,  64U * 1024U, 16U },
+   { 0x08120000U, 128U * 1024U, 17U },
+   { 0x08140000U, 128U * 1024U, 18U },
+   { 0x08160000U, 128U * 1024U, 19U },
+   { 0x08180000U, 128U * 1024U, 20U },
+   { 0x081A0000U, 128U * 1024U, 21U },
+   { 0x081C0000U, 128U * 1024U, 22U },
+   { 0x081E0000U, 128U * 1024U, 23U },
+ };
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Parts                                                                                         */
+ /*-----------------------------------------------------------------------------------------------*/
+ struct STM32F401xEFlash {
+   static constexpr const FlashSectorDescriptor *sectors = kSTM32F4Sectors512K;
+   static constexpr size_t sectorCount = sizeof(kSTM32F4Sectors512K) / sizeof(kSTM32F4Sectors512K[0]);
+   static constexpr uint32_t bankCount = 1U;
+   static constexpr uint32_t bankSize = 512U * 1024U;
+   static constexpr uint32_t programWidth = FAL_FLASH_PROGRAM_WIDTH;
+   static constexpr uint32_t firmwareSize = 256U * 1024U;     // Sectors 0-5
+   static constexpr uint32_t regionBase = 0x08040000U;        // Sectors 6-7
+   static constexpr uint32_t regionSize = 256U * 1024U;
+   static constexpr uint32_t vectorCount = 16U + 85U;
+   static constexpr uint32_t deviceId = 0x433U;
+   static constexpr uint32_t flashSize = 512U * 1024U;
+ };
+
+ struct STM32F411xEFlash {
+   static constexpr const FlashSectorDescriptor *sectors = kSTM32F4Sectors512K;
+   static constexpr size_t sectorCount = sizeof(kSTM32F4Sectors512K) / sizeof(kSTM32F4Sectors512K[0]);
+   static constexpr uint32_t bankCount = 1U;
+   static constexpr uint32_t bankSize = 512U * 1024U;
+   static constexpr uint32_t programWidth = FAL_FLASH_PROGRAM_WIDTH;
+   static constexpr uint32_t firmwareSize = 256U * 1024U;     // Sectors 0-5
+   static constexpr uint32_t regionBase = 0x08040000U;        // Sectors 6-7
+   static constexpr uint32_t regionSize = 256U * 1024U;
+   static constexpr uint32_t vectorCount = 16U + 86U;
+   static constexpr uint32_t deviceId = 0x431U;
+   static constexpr uint32_t flashSize = 512U * 1024U;
+ };
+
+ struct STM32F446xEFlash {
+   static constexpr const FlashSectorDescriptor *sectors = kSTM32F4Sectors512K;
+   static constexpr size_t sectorCount = sizeof(kSTM32F4Sectors512K) / sizeof(kSTM32F4Sectors512K[0]);
+   static constexpr uint32_t bankCount = 1U;
+   static constexpr uint32_t bankSize = 512U * 1024U;
+   static constexpr uint32_t programWidth = FAL_FLASH_PROGRAM_WIDTH;
+   static constexpr uint32_t firmwareSize = 256U * 1024U;     // Sectors 0-5
+   static constexpr uint32_t regionBase = 0x08040000U;        // Sectors 6-7
+   static constexpr uint32_t regionSize = 256U * 1024U;
+   static constexpr uint32_t vectorCount = 16U + 97U;
+   static constexpr uint32_t deviceId = 0x421U;
+   static constexpr uint32_t flashSize = 512U * 1024U;
+ };
+
+ struct STM32F429xIFlash {
+   static constexpr const FlashSectorDescriptor *sectors = kSTM32F4Sectors2M;
+   static constexpr size_t sectorCount = sizeof(kSTM32F4Sectors2M) / sizeof(kSTM32F4Sectors2M[0]);
+   static constexpr uint32_t bankCount = 2U;
+   static constexpr uint32_t bankSize = 1024U * 1024U;
+   static constexpr uint32_t programWidth = FAL_FLASH_PROGRAM_WIDTH;
+   static constexpr uint32_t firmwareSize = 1024U * 1024U;    // Bank 1
+   static constexpr uint32_t regionBase = 0x081C0000U;        // Sectors 22-23 in bank 2
+   static constexpr uint32_t regionSize = 256U * 1024U;
+   static constexpr uint32_t vectorCount = 16U + 91U;
+   static constexpr uint32_t deviceId = 0x419U;
+   static constexpr uint32_t flashSize = 2048U * 1024U;
+ };
+
+ struct STM32F401xEFlashLarge : STM32F401xEFlash {
+   static constexpr uint32_t firmwareSize = 128U * 1024U;     // Sectors 0-4
+   static constexpr uint32_t regionBase = 0x08020000U;        // Sectors 5-7
+   static constexpr uint32_t regionSize = 384U * 1024U;
+ };
+
+ struct STM32F411xEFlashLarge : STM32F411xEFlash {
+   static constexpr uint32_t firmwareSize = 128U * 1024U;     // Sectors 0-4
+   static constexpr uint32_t regionBase = 0x08020000U;        // Sectors 5-7
+   static constexpr uint32_t regionSize = 384U * 1024U;
+ };
+
+ struct STM32F446xEFlashLarge : STM32F446xEFlash {
+   static constexpr uint32_t firmwareSize = 128U * 1024U;     // Sectors 0-4
+   static constexpr uint32_t regionBase = 0x08020000U;        // Sectors 5-7
+   static constexpr uint32_t regionSize = 384U * 1024U;
+ };
+
+ struct STM32F429xIFlashLarge : STM32F429xIFlash {
+   static constexpr uint32_t regionBase = 0x08120000U;        // Sectors 17-23 in bank 2
+   static constexpr uint32_t regionSize = 896U * 1024U;
+ };
+
+ /* Part the build is specialized for (override with -D, e.g. -DFAL_FLASH_PART=STM32F429xIFlash) */
+ #ifndef FAL_FLASH_PART
+   #if defined(STM32F411xE)
+     #define FAL_FLASH_PART STM32F411xEFlash
+   #elif defined(STM32F446xx)
+     #define FAL_FLASH_PART STM32F446xEFlash
+   #elif defined(STM32F429xx) || defined(STM32F439xx)
+     #define FAL_FLASH_PART STM32F429xIFlash
+     #define FAL_FLASH_DUAL_BANK (1)
+   #else
+     #define FAL_FLASH_PART STM32F401xEFlash
+   #endif
+ #endif
+
+ /* Compile every part above and let the factory choose from DBGMCU_IDCODE and the flash size,
+    FAL_FLASH_PART is then ignored (override with -D) */
+ #ifndef FAL_FLASH_RUNTIME_DETECT
+   #define FAL_FLASH_RUNTIME_DETECT (0)
+ #endif
+
+ /* Use the read-while-write FAL, the part must keep firmware and region in different banks */
+ #ifndef FAL_FLASH_DUAL_BANK
+   #define FAL_FLASH_DUAL_BANK (0)
+ #endif
+
+ #endif // STM32F4_FLASH_PARTS_H
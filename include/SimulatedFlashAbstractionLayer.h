@@ -0,0 +1,121 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : SimulatedFlashAbstractionLayer.h
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : Host-native simulation of STM32F4 internal flash with a datasheet timing model
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : native
+ * @compiler : gcc
+ *
+ **************************************************************************************************
+ *
+ * Emulates the LittleFS region of a part from STM32F4FlashParts.h in host RAM with NOR
+ * semantics: erase sets whole sectors to 0xFF, programming can only clear bits. Every operation
+ * adds its datasheet time to a simulated clock instead of sleeping, so a benchmark that would
+ * take minutes of erases on the board finishes in milliseconds:
+ *
+ *   SimulatedFlashAbstractionLayer<STM32F401xEFlash> flash;
+ *   FlashTranslationLayer<SimulatedFlashAbstractionLayer<STM32F401xEFlash>> ftl(&flash, 128U * 1024U, 3U, 2048U);
+ *   ...
+ *   printf("%llu us\n", flash.elapsedNs() / 1000U);
+ *
+ * Statistics latencies are simulated nanoseconds (cyclesPerMicrosecond is 1000 on the host).
+ *
+ * cutPowerAfter() injects a power loss into a later program or erase. The interrupted operation
+ * is torn: a program reaches the cells only for a random number of leading program units, and an
+ * erase stops after a random number of bytes of the sector it was working on, leaving the rest
+ * of that sector as it was. From then on every call fails until powerOn().
+ *
+ */
+
+ #ifndef SIMULATED_FLASH_ABSTRACTION_LAYER_H
+ #define SIMULATED_FLASH_ABSTRACTION_LAYER_H
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Includes                                                                                      */
+ /*-----------------------------------------------------------------------------------------------*/
+ #include "IFlashAbstractionLayer.h"
+ #include "STM32F4FlashParts.h"
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Types                                                                                         */
+ /*-----------------------------------------------------------------------------------------------*/
+ // Typical times from the STM32F401xE datasheet (DS10086, flash memory programming table)
+ struct SimulatedFlashTiming {
+   uint32_t programNs;         // One program operation of any width (tPROG)
+   uint32_t readWordNs;        // One 32-bit read, ART accelerator streaming at 84 MHz
+   uint32_t erase16KNs;        // Sector erase by size at the part's parallelism (tERASE)
+   uint32_t erase64KNs;
+   uint32_t erase128KNs;
+ };
+
+ /*-----------------------------------------------------------------------------------------------*/
+ /* Classes                                                                                       */
+ /*-----------------------------------------------------------------------------------------------*/
+ template <typename Part>
+ class SimulatedFlashAbstractionLayer final : public IFlashAbstractionLayer {
+ public:
+   // Constructor and Destructor, timing nullptr selects the datasheet values for Part
+   explicit SimulatedFlashAbstractionLayer(const SimulatedFlashTiming *timing = nullptr);
+   ~SimulatedFlashAbstractionLayer() override;
+
+   // Override interface methods
+   int erase(long offset, size_t size) override;
+   int write(long offset, const uint8_t *buf, size_t size) override;
+   int read(long offset, uint8_t *buf, size_t size) override;
+   int sync() override;
+   bool verify_flash_erased(uint32_t addr, size_t size) override;
+   const uint8_t *map(long offset, size_t size) override;
+   bool getStats(FalStats *out) const override;
+   void resetStats() override;
+
+   // Datasheet timing at the erase parallelism of a program width
+   static SimulatedFlashTiming datasheetTiming(uint32_t programWidth);
+
+   // Simulated time spent in flash operations since construction or resetTime()
+   uint64_t elapsedNs(void) const { return elapsedNs_; }
+   void resetTime(void) { elapsedNs_ = 0; }
+
+   // Programs that tried to turn a 0 bit back into 1, the bit stayed 0 as on real NOR
+   uint32_t programConflicts(void) const { return conflicts_; }
+
+   // Raw region image, e.g. to save it or to inject bit errors
+   uint8_t *image(void) { return mem_; }
+
+   // Lose power during the operations-th program or erase from now, seed picks how far it got
+   void cutPowerAfter(uint32_t operations, uint32_t seed);
+   void powerOn(void) { cutAfter_ = 0; powerLost_ = false; }
+   bool powerLost(void) const { return powerLost_; }
+
+   // Programs and erases started since construction, including refused ones after a power loss
+   uint32_t operations(void) const { return operations_; }
+
+ private:
+   // Private methods
+   static bool validRange(long offset, size_t size);
+   uint32_t eraseTimeNs(uint32_t sectorSize) const;
+   bool tearNow(void);
+   uint32_t tornLength(uint32_t size);
+
+   static constexpr int32_t regionFirstIndex = flashSectorIndex(Part::sectors, Part::sectorCount, Part::regionBase);
+   static constexpr uint32_t regionSectors =
+       (uint32_t)(flashSectorIndex(Part::sectors, Part::sectorCount, Part::regionBase + Part::regionSize - 1U) - regionFirstIndex + 1);
+
+   uint8_t *mem_;
+   SimulatedFlashTiming timing_;
+   uint64_t elapsedNs_;
+   uint32_t conflicts_;
+   uint32_t operations_;
+   uint32_t cutAfter_;         // Operations left until the power loss, 0 when none is armed
+   uint32_t seed_;
+   bool powerLost_;
+   FalStatsRecorder stats_;
+ };
+
+ #endif // SIMULATED_FLASH_ABSTRACTION_LAYER_H
@@ -65,6 +65,48 @@ typedef uint32_t lfs_block_t;
 #define LFS_ATTR_MAX 1022
 #endif
 
+// Maximum number of read caches in addition to the one in read_buffer, see
+// read_cache_count. Each one costs a cache header in lfs_t even when unused.
+// Must be >= 1. Only with LFS_READ_CACHE defined.
+#ifdef LFS_READ_CACHE
+#ifndef LFS_READ_CACHE_MAX
+#define LFS_READ_CACHE_MAX 4
+#endif
+#endif
+
+// Maximum number of metadata pairs in the fetch cache, see fetch_cache_count.
+// Each one costs an entry in lfs_t even when unused. Must be >= 1. Only with
+// LFS_FETCH_CACHE defined.
+#ifdef LFS_FETCH_CACHE
+#ifndef LFS_FETCH_CACHE_MAX
+#define LFS_FETCH_CACHE_MAX 4
+#endif
+#endif
+
+// Maximum number of paths in the path lookup cache, see dentry_cache_count.
+// Each one costs an entry in lfs_t even when unused, and lookups are a linear
+// scan, O(dentry_cache_count). Must be >= 1. Only with LFS_DENTRY_CACHE
+// defined.
+#ifdef LFS_DENTRY_CACHE
+#ifndef LFS_DENTRY_CACHE_MAX
+#define LFS_DENTRY_CACHE_MAX 8
+#endif
+
+// Longest path, in bytes, the path lookup cache remembers. Longer paths are
+// always resolved name by name.
+#ifndef LFS_DENTRY_PATH_MAX
+#define LFS_DENTRY_PATH_MAX 48
+#endif
+#endif
+
+// Cache statistics, see lfs_fs_cachestat, are kept if any of the optional
+// caches LFS_READ_CACHE, LFS_FETCH_CACHE, LFS_DENTRY_CACHE or LFS_CTZ_CACHE
+// is compiled in.
+#if defined(LFS_READ_CACHE) || defined(LFS_FETCH_CACHE) \
+        || defined(LFS_DENTRY_CACHE) || defined(LFS_CTZ_CACHE)
+#define LFS_CACHESTAT
+#endif
+
 // Possible error codes, these are negative to allow
 // valid positive return values
 enum lfs_error {
@@ -283,6 +325,43 @@ struct lfs_config {
     // Set to -1 to disable inlined files.
     lfs_size_t inline_max;
 
+#ifdef LFS_READ_CACHE
+    // Optional number of read caches in addition to the one in read_buffer,
+    // at most LFS_READ_CACHE_MAX. Metadata and CTZ skip-list reads then load
+    // the least recently used of the read caches, so interleaved reads of a
+    // few blocks stop evicting each other. Each costs cache_size bytes.
+    // Defaults to a single read cache when zero.
+    lfs_size_t read_cache_count;
+
+    // Optional statically allocated buffer for the additional read caches.
+    // Must be read_cache_count*cache_size. By default lfs_malloc is used to
+    // allocate this buffer.
+    void *read_cache_buffer;
+#endif
+
+#ifdef LFS_FETCH_CACHE
+    // Optional number of metadata pairs whose last fetch is remembered, at
+    // most LFS_FETCH_CACHE_MAX. Fetching such a pair again while neither of
+    // its blocks has been programmed or erased skips the crc scan of its
+    // commits. Defaults to no fetch cache when zero.
+    lfs_size_t fetch_cache_count;
+#endif
+
+#ifdef LFS_DENTRY_CACHE
+    // Optional number of resolved paths to remember, at most
+    // LFS_DENTRY_CACHE_MAX. Looking up a remembered path again fetches the
+    // metadata pair holding its entry directly instead of searching every
+    // directory on the way. Each costs LFS_DENTRY_PATH_MAX bytes. Every
+    // lookup scans all entries, comparing a crc of the path first, so keep
+    // the count small. Defaults to no path lookup cache when zero.
+    lfs_size_t dentry_cache_count;
+
+    // Optional statically allocated buffer for the remembered paths. Must be
+    // dentry_cache_count*LFS_DENTRY_PATH_MAX. By default lfs_malloc is used
+    // to allocate this buffer.
+    void *dentry_cache_buffer;
+#endif
+
 #ifdef LFS_MULTIVERSION
     // On-disk version to use when writing in the form of 16-bit major version
     // + 16-bit minor version. This limiting metadata to what is supported by
@@ -328,6 +407,38 @@ struct lfs_fsinfo {
     lfs_size_t attr_max;
 };
 
+#ifdef LFS_CACHESTAT
+// Cache statistics structure, counted since mount
+struct lfs_cachestat {
+    // Metadata and CTZ skip-list reads served from a read cache.
+    uint32_t rcache_hits;
+
+    // Metadata and CTZ skip-list reads that loaded a read cache from the
+    // block device.
+    uint32_t rcache_misses;
+
+    // Metadata pair fetches that found the pair in the fetch cache.
+    uint32_t fetch_hits;
+
+    // Metadata pair fetches that scanned and checked every commit.
+    uint32_t fetch_misses;
+
+    // Path lookups that found the path in the path lookup cache.
+    uint32_t dentry_hits;
+
+    // Path lookups that searched directory by directory.
+    uint32_t dentry_misses;
+
+    // Skip-list walks of files with a position cache that started from a
+    // remembered block.
+    uint32_t ctz_hits;
+
+    // Skip-list walks of files with a position cache that started from the
+    // end of the file.
+    uint32_t ctz_misses;
+};
+#endif
+
 // Custom attribute structure, used to describe custom attributes
 // committed atomically during file writes.
 struct lfs_attr {
@@ -342,6 +453,15 @@ struct lfs_attr {
     lfs_size_t size;
 };
 
+#ifdef LFS_CTZ_CACHE
+// Position of one block in a file's CTZ skip-list, the entries of the
+// optional per-file position cache
+struct lfs_ctzpos {
+    lfs_off_t index;
+    lfs_block_t block;
+};
+#endif
+
 // Optional configuration provided during lfs_file_opencfg
 struct lfs_file_config {
     // Optional statically allocated file buffer. Must be cache_size.
@@ -363,6 +483,20 @@ struct lfs_file_config {
 
     // Number of custom attributes in the list
     lfs_size_t attr_count;
+
+#ifdef LFS_CTZ_CACHE
+    // Optional number of skip-list positions the file remembers. Half of them
+    // are checkpoints spread along the file, the rest the most recently
+    // resolved positions. A seek then walks the skip-list from the closest
+    // remembered block after the target instead of from the end of the file.
+    // Forgotten whenever the file's contents are rewritten. Defaults to no
+    // position cache when zero.
+    lfs_size_t ctz_cache_count;
+
+    // Optional statically allocated position cache. Must be ctz_cache_count
+    // entries. By default lfs_malloc is used to allocate this buffer.
+    struct lfs_ctzpos *ctz_cache;
+#endif
 };
 
 
@@ -414,6 +548,14 @@ typedef struct lfs_file {
     lfs_off_t off;
     lfs_cache_t cache;
 
+#ifdef LFS_CTZ_CACHE
+    struct lfs_ctzcache {
+        struct lfs_ctzpos *pos;
+        lfs_size_t count;
+        lfs_size_t next;
+    } ctzc;
+#endif
+
     const struct lfs_file_config *cfg;
 } lfs_file_t;
 
@@ -436,6 +578,46 @@ typedef struct lfs {
     lfs_cache_t rcache;
     lfs_cache_t pcache;
 
+#ifdef LFS_READ_CACHE
+    struct lfs_rcaches {
+        lfs_cache_t way[LFS_READ_CACHE_MAX];
+        uint32_t used[LFS_READ_CACHE_MAX+1];
+        uint32_t tick;
+        lfs_size_t count;
+    } rcaches;
+#endif
+
+#ifdef LFS_FETCH_CACHE
+    struct lfs_fcache {
+        struct lfs_fcache_entry {
+            lfs_mdir_t m;
+            lfs_off_t crcoff;
+            uint32_t crc;
+            lfs_gstate_t gdelta;
+            bool hasgdelta;
+            uint32_t used;
+        } entry[LFS_FETCH_CACHE_MAX];
+        uint32_t tick;
+        lfs_size_t count;
+    } fcache;
+#endif
+
+#ifdef LFS_DENTRY_CACHE
+    struct lfs_dcache {
+        struct lfs_dcache_entry {
+            lfs_block_t pair[2];
+            uint32_t tag;
+            uint32_t hash;
+            lfs_size_t len;
+            lfs_size_t nameoff;
+            uint32_t used;
+        } entry[LFS_DENTRY_CACHE_MAX];
+        char *path;
+        uint32_t tick;
+        lfs_size_t count;
+    } dcache;
+#endif
+
     lfs_block_t root[2];
     struct lfs_mlist {
         struct lfs_mlist *next;
@@ -463,6 +645,9 @@ typedef struct lfs {
     lfs_size_t file_max;
     lfs_size_t attr_max;
     lfs_size_t inline_max;
+#ifdef LFS_CACHESTAT
+    struct lfs_cachestat cachestat;
+#endif
 
 #ifdef LFS_MIGRATE
     struct lfs1 *lfs1;
@@ -656,6 +841,25 @@ int lfs_file_rewind(lfs_t *lfs, lfs_file_t *file);
 // Returns the size of the file, or a negative error code on failure.
 lfs_soff_t lfs_file_size(lfs_t *lfs, lfs_file_t *file);
 
+// Walk the data blocks of a file without copying
+//
+// Calls cb once per data block, last block first, with the file position of
+// the first byte in the block and the offset and size of the file data
+// inside that block. Pending writes are flushed first. Together with a
+// memory-mapped block device this gives direct pointers to file contents.
+// Inlined files have no data blocks and return LFS_ERR_INVAL.
+//
+// The block addresses are only valid until the next write on the filesystem,
+// which is excluded for the duration of the walk by holding the lock with
+// LFS_THREADSAFE. cb must not call other lfs functions.
+//
+// If cb returns a non-zero value, the walk stops and that value is returned.
+// Returns a negative error code on failure.
+int lfs_file_spans(lfs_t *lfs, lfs_file_t *file,
+        int (*cb)(void *data, lfs_off_t pos,
+            lfs_block_t block, lfs_off_t off, lfs_size_t size),
+        void *data);
+
 
 /// Directory operations ///
 
@@ -715,6 +919,14 @@ int lfs_dir_rewind(lfs_t *lfs, lfs_dir_t *dir);
 // Returns a negative error code on failure.
 int lfs_fs_stat(lfs_t *lfs, struct lfs_fsinfo *fsinfo);
 
+#ifdef LFS_CACHESTAT
+// Find the cache statistics
+//
+// Fills out the cachestat structure with the counters since mount.
+// Returns a negative error code on failure.
+int lfs_fs_cachestat(lfs_t *lfs, struct lfs_cachestat *cachestat);
+#endif
+
 // Finds the current size of the filesystem
 //
 // Note: Result is best effort. If files share COW structures, the returned
@@ -794,6 +1006,97 @@ int lfs_migrate(lfs_t *lfs, const struct lfs_config *cfg);
 #endif
 
 
+/// Profiling ///
+#ifdef LFS_PROFILE
+// Number of log2 latency buckets, bucket i counts calls that took
+// [2^i, 2^(i+1)) cycles, the last bucket also counts everything longer
+#ifndef LFS_PROFILE_BUCKETS
+#define LFS_PROFILE_BUCKETS 32
+#endif
+
+// Public calls with their own histogram, in lfs.c wrapper order
+enum lfs_profile_call {
+    LFS_PROFILE_FORMAT,
+    LFS_PROFILE_MOUNT,
+    LFS_PROFILE_UNMOUNT,
+    LFS_PROFILE_REMOVE,
+    LFS_PROFILE_RENAME,
+    LFS_PROFILE_STAT,
+    LFS_PROFILE_GETATTR,
+    LFS_PROFILE_SETATTR,
+    LFS_PROFILE_REMOVEATTR,
+    LFS_PROFILE_FILE_OPEN,
+    LFS_PROFILE_FILE_OPENCFG,
+    LFS_PROFILE_FILE_CLOSE,
+    LFS_PROFILE_FILE_SYNC,
+    LFS_PROFILE_FILE_READ,
+    LFS_PROFILE_FILE_WRITE,
+    LFS_PROFILE_FILE_SEEK,
+    LFS_PROFILE_FILE_TRUNCATE,
+    LFS_PROFILE_FILE_TELL,
+    LFS_PROFILE_FILE_REWIND,
+    LFS_PROFILE_FILE_SIZE,
+    LFS_PROFILE_FILE_SPANS,
+    LFS_PROFILE_MKDIR,
+    LFS_PROFILE_DIR_OPEN,
+    LFS_PROFILE_DIR_CLOSE,
+    LFS_PROFILE_DIR_READ,
+    LFS_PROFILE_DIR_SEEK,
+    LFS_PROFILE_DIR_TELL,
+    LFS_PROFILE_DIR_REWIND,
+    LFS_PROFILE_FS_STAT,
+    LFS_PROFILE_FS_SIZE,
+    LFS_PROFILE_FS_TRAVERSE,
+    LFS_PROFILE_FS_MKCONSISTENT,
+    LFS_PROFILE_FS_GC,
+    LFS_PROFILE_FS_GROW,
+    LFS_PROFILE_MIGRATE,
+#ifdef LFS_CACHESTAT
+    LFS_PROFILE_FS_CACHESTAT,
+#endif
+    LFS_PROFILE_CALL_COUNT,
+};
+
+// Internal phases a call's time is attributed to. Phases nest, a phase
+// only gets the time not spent in phases it called, so an erase during a
+// compaction counts as erase.
+enum lfs_profile_phase {
+    LFS_PROFILE_DIR_COMPACT,
+    LFS_PROFILE_ALLOC_SCAN,
+    LFS_PROFILE_BD_ERASE,
+    LFS_PROFILE_BD_FLUSH,
+    LFS_PROFILE_PHASE_COUNT,
+};
+
+struct lfs_profile_call_stats {
+    uint32_t count;
+    uint32_t max;
+    uint64_t total;
+    uint32_t hist[LFS_PROFILE_BUCKETS];
+    uint32_t phase_count[LFS_PROFILE_PHASE_COUNT];
+    uint64_t phase_total[LFS_PROFILE_PHASE_COUNT];
+};
+
+// Cycle counter supplied by the port, usually DWT->CYCCNT. Only
+// differences are used, so it may wrap.
+uint32_t lfs_profile_cycles(void);
+
+// Counters of every call since the last lfs_profile_reset, shared by all
+// filesystems. Not synchronized, read them while no call is running.
+const struct lfs_profile_call_stats *lfs_profile_get(
+        enum lfs_profile_call call);
+
+// Name of a call without the lfs_ prefix, e.g. "file_write"
+const char *lfs_profile_call_name(enum lfs_profile_call call);
+
+// Name of a phase, e.g. "dir_compact"
+const char *lfs_profile_phase_name(enum lfs_profile_phase phase);
+
+// Clear every counter
+void lfs_profile_reset(void);
+#endif
+
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
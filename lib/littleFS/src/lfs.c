@@ -26,6 +26,84 @@ enum {
 };
 
 
+/// Profiling ///
+#ifdef LFS_PROFILE
+// nesting depth of phases that are attributed, deeper phases are counted
+// but their time goes to the phase at this depth
+#define LFS_PROFILE_DEPTH 8
+
+static struct lfs_profile_call_stats lfs_profile_calls[LFS_PROFILE_CALL_COUNT];
+
+static struct {
+    struct lfs_profile_call_stats *call;
+    uint32_t start;
+    uint32_t mark;
+    uint8_t depth;
+    uint8_t stack[LFS_PROFILE_DEPTH];
+} lfs_profile_state;
+
+static void lfs_profile_begin(enum lfs_profile_call call) {
+    lfs_profile_state.call = &lfs_profile_calls[call];
+    lfs_profile_state.depth = 0;
+    lfs_profile_state.start = lfs_profile_cycles();
+    lfs_profile_state.mark = lfs_profile_state.start;
+}
+
+static void lfs_profile_end(void) {
+    struct lfs_profile_call_stats *stats = lfs_profile_state.call;
+    uint32_t elapsed = lfs_profile_cycles() - lfs_profile_state.start;
+
+    // floor(log2(elapsed)), with 0 and 1 cycle both in the first bucket
+    uint32_t bucket = (elapsed > 1) ? lfs_npw2(elapsed + 1) - 1 : 0;
+    stats->hist[lfs_min(bucket, LFS_PROFILE_BUCKETS-1)] += 1;
+    stats->count += 1;
+    stats->total += elapsed;
+    stats->max = lfs_max(stats->max, elapsed);
+    lfs_profile_state.call = NULL;
+}
+
+// every attributed phase is on the write path
+#ifndef LFS_READONLY
+static void lfs_profile_credit(uint32_t now) {
+    // time since the last phase boundary belongs to the innermost phase
+    if (lfs_profile_state.call && lfs_profile_state.depth > 0) {
+        uint8_t depth = lfs_min(lfs_profile_state.depth, LFS_PROFILE_DEPTH);
+        lfs_profile_state.call->phase_total[
+                lfs_profile_state.stack[depth-1]]
+                += now - lfs_profile_state.mark;
+    }
+    lfs_profile_state.mark = now;
+}
+
+static void lfs_profile_enter(enum lfs_profile_phase phase) {
+    lfs_profile_credit(lfs_profile_cycles());
+    if (lfs_profile_state.depth < LFS_PROFILE_DEPTH) {
+        lfs_profile_state.stack[lfs_profile_state.depth] = phase;
+    }
+    lfs_profile_state.depth += 1;
+    if (lfs_profile_state.call) {
+        lfs_profile_state.call->phase_count[phase] += 1;
+    }
+}
+
+static void lfs_profile_leave(void) {
+    lfs_profile_credit(lfs_profile_cycles());
+    lfs_profile_state.depth -= 1;
+}
+#endif
+
+#define LFS_PROFILE_BEGIN(call) lfs_profile_begin(call)
+#define LFS_PROFILE_END() lfs_profile_end()
+#define LFS_PROFILE_ENTER(phase) lfs_profile_enter(phase)
+#define LFS_PROFILE_LEAVE() lfs_profile_leave()
+#else
+#define LFS_PROFILE_BEGIN(call)
+#define LFS_PROFILE_END()
+#define LFS_PROFILE_ENTER(phase)
+#define LFS_PROFILE_LEAVE()
+#endif
+
+
 /// Caching block device operations ///
 
 static inline void lfs_cache_drop(lfs_t *lfs, lfs_cache_t *rcache) {
@@ -41,6 +119,70 @@ static inline void lfs_cache_zero(lfs_t *lfs, lfs_cache_t *pcache) {
     pcache->block = LFS_BLOCK_NULL;
 }
 
+#ifdef LFS_READ_CACHE
+// the shared read caches, way 0 is lfs->rcache and the rest are the
+// optional read_cache_count extra caches
+static inline lfs_cache_t *lfs_rcache_way(lfs_t *lfs, lfs_size_t i) {
+    return (i == 0) ? &lfs->rcache : &lfs->rcaches.way[i-1];
+}
+
+// find the way holding off, or the least recently used way to load
+static lfs_size_t lfs_rcache_lookup(lfs_t *lfs,
+        lfs_block_t block, lfs_off_t off) {
+    lfs_size_t lru = 0;
+    for (lfs_size_t i = 0; i <= lfs->rcaches.count; i++) {
+        const lfs_cache_t *way = lfs_rcache_way(lfs, i);
+        if (block == way->block &&
+                off >= way->off && off < way->off + way->size) {
+            return i;
+        }
+
+        // ages are relative to tick so wrapping is harmless
+        if (lfs->rcaches.tick - lfs->rcaches.used[i]
+                > lfs->rcaches.tick - lfs->rcaches.used[lru]) {
+            lru = i;
+        }
+    }
+
+    return lru;
+}
+
+static inline void lfs_rcache_touch(lfs_t *lfs, lfs_size_t i) {
+    lfs->rcaches.tick += 1;
+    lfs->rcaches.used[i] = lfs->rcaches.tick;
+}
+
+#ifndef LFS_READONLY
+// a block is about to change on disk, extra read caches live long enough
+// that they must not keep its old contents
+static void lfs_rcache_dropblock(lfs_t *lfs, lfs_block_t block) {
+    if (lfs->rcaches.count == 0) {
+        return;
+    }
+
+    for (lfs_size_t i = 0; i <= lfs->rcaches.count; i++) {
+        lfs_cache_t *way = lfs_rcache_way(lfs, i);
+        if (way->block == block) {
+            lfs_cache_drop(lfs, way);
+        }
+    }
+}
+#endif
+#endif
+
+#if defined(LFS_FETCH_CACHE) && !defined(LFS_READONLY)
+// same for remembered fetches of a metadata pair using the block
+static void lfs_fcache_dropblock(lfs_t *lfs, lfs_block_t block) {
+    for (lfs_size_t i = 0; i < lfs->fcache.count; i++) {
+        struct lfs_fcache_entry *e = &lfs->fcache.entry[i];
+        if (e->m.pair[0] == block || e->m.pair[1] == block) {
+            e->m.pair[0] = LFS_BLOCK_NULL;
+            e->m.pair[1] = LFS_BLOCK_NULL;
+        }
+    }
+}
+#endif
+
 static int lfs_bd_read(lfs_t *lfs,
         const lfs_cache_t *pcache, lfs_cache_t *rcache, lfs_size_t hint,
         lfs_block_t block, lfs_off_t off,
@@ -51,6 +193,12 @@ static int lfs_bd_read(lfs_t *lfs,
         return LFS_ERR_CORRUPT;
     }
 
+#ifdef LFS_READ_CACHE
+    // metadata and ctz reads share the read caches, others bring their own
+    bool shared = (rcache == &lfs->rcache);
+    lfs_size_t way = 0;
+#endif
+
     while (size > 0) {
         lfs_size_t diff = size;
 
@@ -71,12 +219,25 @@ static int lfs_bd_read(lfs_t *lfs,
             diff = lfs_min(diff, pcache->off-off);
         }
 
+#ifdef LFS_READ_CACHE
+        if (shared) {
+            way = lfs_rcache_lookup(lfs, block, off);
+            rcache = lfs_rcache_way(lfs, way);
+        }
+#endif
+
         if (block == rcache->block &&
                 off < rcache->off + rcache->size) {
             if (off >= rcache->off) {
                 // is already in rcache?
                 diff = lfs_min(diff, rcache->size - (off-rcache->off));
                 memcpy(data, &rcache->buffer[off-rcache->off], diff);
+            #ifdef LFS_READ_CACHE
+                if (shared) {
+                    lfs_rcache_touch(lfs, way);
+                    lfs->cachestat.rcache_hits += 1;
+                }
+            #endif
 
                 data += diff;
                 off += diff;
@@ -113,6 +274,12 @@ static int lfs_bd_read(lfs_t *lfs,
                     lfs->cfg->block_size)
                 - rcache->off,
                 lfs->cfg->cache_size);
+    #ifdef LFS_READ_CACHE
+        if (shared) {
+            lfs_rcache_touch(lfs, way);
+            lfs->cachestat.rcache_misses += 1;
+        }
+    #endif
         int err = lfs->cfg->read(lfs->cfg, rcache->block,
                 rcache->off, rcache->buffer, rcache->size);
         LFS_ASSERT(err <= 0);
@@ -177,11 +344,19 @@ static int lfs_bd_flush(lfs_t *lfs,
         lfs_cache_t *pcache, lfs_cache_t *rcache, bool validate) {
     if (pcache->block != LFS_BLOCK_NULL && pcache->block != LFS_BLOCK_INLINE) {
         LFS_ASSERT(pcache->block < lfs->block_count);
+        LFS_PROFILE_ENTER(LFS_PROFILE_BD_FLUSH);
         lfs_size_t diff = lfs_alignup(pcache->size, lfs->cfg->prog_size);
+    #ifdef LFS_READ_CACHE
+        lfs_rcache_dropblock(lfs, pcache->block);
+    #endif
+    #ifdef LFS_FETCH_CACHE
+        lfs_fcache_dropblock(lfs, pcache->block);
+    #endif
         int err = lfs->cfg->prog(lfs->cfg, pcache->block,
                 pcache->off, pcache->buffer, diff);
         LFS_ASSERT(err <= 0);
         if (err) {
+            LFS_PROFILE_LEAVE();
             return err;
         }
 
@@ -192,15 +367,18 @@ static int lfs_bd_flush(lfs_t *lfs,
                     NULL, rcache, diff,
                     pcache->block, pcache->off, pcache->buffer, diff);
             if (res < 0) {
+                LFS_PROFILE_LEAVE();
                 return res;
             }
 
             if (res != LFS_CMP_EQ) {
+                LFS_PROFILE_LEAVE();
                 return LFS_ERR_CORRUPT;
             }
         }
 
         lfs_cache_zero(lfs, pcache);
+        LFS_PROFILE_LEAVE();
     }
 
     return 0;
@@ -274,8 +452,16 @@ static int lfs_bd_prog(lfs_t *lfs,
 #ifndef LFS_READONLY
 static int lfs_bd_erase(lfs_t *lfs, lfs_block_t block) {
     LFS_ASSERT(block < lfs->block_count);
+    LFS_PROFILE_ENTER(LFS_PROFILE_BD_ERASE);
+#ifdef LFS_READ_CACHE
+    lfs_rcache_dropblock(lfs, block);
+#endif
+#ifdef LFS_FETCH_CACHE
+    lfs_fcache_dropblock(lfs, block);
+#endif
     int err = lfs->cfg->erase(lfs->cfg, block);
     LFS_ASSERT(err <= 0);
+    LFS_PROFILE_LEAVE();
     return err;
 }
 #endif
@@ -650,8 +836,10 @@ static int lfs_alloc_scan(lfs_t *lfs) {
             lfs->lookahead.ckpoint);
 
     // find mask of free blocks from tree
+    LFS_PROFILE_ENTER(LFS_PROFILE_ALLOC_SCAN);
     memset(lfs->lookahead.buffer, 0, lfs->cfg->lookahead_size);
     int err = lfs_fs_traverse_(lfs, lfs_alloc_lookahead, lfs, true);
+    LFS_PROFILE_LEAVE();
     if (err) {
         lfs_alloc_drop(lfs);
         return err;
@@ -1104,6 +1292,51 @@ popped:
 }
 #endif
 
+#ifdef LFS_FETCH_CACHE
+// the fetch cache remembers fully checked fetches, a pair that has not been
+// programmed or erased since (see lfs_fcache_dropblock) needs no crc scan
+static struct lfs_fcache_entry *lfs_fcache_lookup(lfs_t *lfs,
+        const lfs_mdir_t *dir) {
+    for (lfs_size_t i = 0; i < lfs->fcache.count; i++) {
+        struct lfs_fcache_entry *e = &lfs->fcache.entry[i];
+        if (e->m.pair[0] == dir->pair[0] && e->m.pair[1] == dir->pair[1]
+                && e->m.rev == dir->rev) {
+            return e;
+        }
+    }
+
+    return NULL;
+}
+
+static void lfs_fcache_store(lfs_t *lfs, const lfs_mdir_t *dir,
+        lfs_off_t crcoff, uint32_t crc) {
+    if (lfs->fcache.count == 0) {
+        return;
+    }
+
+    // replace an older fetch of the same pair, or the least recently used
+    struct lfs_fcache_entry *e = &lfs->fcache.entry[0];
+    for (lfs_size_t i = 0; i < lfs->fcache.count; i++) {
+        struct lfs_fcache_entry *c = &lfs->fcache.entry[i];
+        if (lfs_pair_issync(c->m.pair, dir->pair)) {
+            e = c;
+            break;
+        }
+
+        if (lfs->fcache.tick - c->used > lfs->fcache.tick - e->used) {
+            e = c;
+        }
+    }
+
+    e->m = *dir;
+    e->crcoff = crcoff;
+    e->crc = crc;
+    e->hasgdelta = false;
+    lfs->fcache.tick += 1;
+    e->used = lfs->fcache.tick;
+}
+#endif
+
 static lfs_stag_t lfs_dir_fetchmatch(lfs_t *lfs,
         lfs_mdir_t *dir, const lfs_block_t pair[2],
         lfs_tag_t fmask, lfs_tag_t ftag, uint16_t *id,
@@ -1142,6 +1375,41 @@ static lfs_stag_t lfs_dir_fetchmatch(lfs_t *lfs,
     dir->rev = revs[(r+0)%2];
     dir->off = 0; // nonzero = found some commits
 
+#ifdef LFS_FETCH_CACHE
+    // fetched before? a match still needs the tags, but not their crcs
+    struct lfs_fcache_entry *hit = lfs_fcache_lookup(lfs, dir);
+    if (hit) {
+        lfs->fcache.tick += 1;
+        hit->used = lfs->fcache.tick;
+    }
+
+    // nothing to match? the cached state is the answer, as long as the crc
+    // of the last commit is still in place
+    if (hit && !cb) {
+        uint32_t crc;
+        int err = lfs_bd_read(lfs,
+                NULL, &lfs->rcache, sizeof(crc),
+                hit->m.pair[0], hit->crcoff, &crc, sizeof(crc));
+        if (err && err != LFS_ERR_CORRUPT) {
+            return err;
+        }
+
+        if (!err && lfs_fromle32(crc) == hit->crc) {
+            lfs->cachestat.fetch_hits += 1;
+            *dir = hit->m;
+            if (id) {
+                *id = lfs_min(lfs_tag_id(besttag), dir->count);
+            }
+
+            return (lfs_tag_id(besttag) < dir->count) ? LFS_ERR_NOENT : 0;
+        }
+
+        hit->m.pair[0] = LFS_BLOCK_NULL;
+        hit->m.pair[1] = LFS_BLOCK_NULL;
+        hit = NULL;
+    }
+
+#endif
     // now scan tags to fetch the actual dir and find possible match
     for (int i = 0; i < 2; i++) {
         lfs_off_t off = 0;
@@ -1157,6 +1425,12 @@ static lfs_stag_t lfs_dir_fetchmatch(lfs_t *lfs,
         bool hasfcrc = false;
         struct lfs_fcrc fcrc;
 
+    #ifdef LFS_FETCH_CACHE
+        // where the crc of the last valid commit lives, for the fetch cache
+        lfs_off_t crcoff = 0;
+        uint32_t lastcrc = 0;
+
+    #endif
         dir->rev = lfs_tole32(dir->rev);
         uint32_t crc = lfs_crc(0xffffffff, &dir->rev, sizeof(dir->rev));
         dir->rev = lfs_fromle32(dir->rev);
@@ -1165,6 +1439,13 @@ static lfs_stag_t lfs_dir_fetchmatch(lfs_t *lfs,
             // extract next tag
             lfs_tag_t tag;
             off += lfs_tag_dsize(ptag);
+        #ifdef LFS_FETCH_CACHE
+            if (hit && off >= hit->m.off) {
+                // the rest was already found to be erased or invalid
+                break;
+            }
+
+        #endif
             int err = lfs_bd_read(lfs,
                     NULL, &lfs->rcache, lfs->cfg->block_size,
                     dir->pair[0], off, &tag, sizeof(tag));
@@ -1205,10 +1486,23 @@ static lfs_stag_t lfs_dir_fetchmatch(lfs_t *lfs,
                 }
                 dcrc = lfs_fromle32(dcrc);
 
+            #ifdef LFS_FETCH_CACHE
+                if (hit) {
+                    // checked by the fetch that filled the cache, the
+                    // entries were not crced this time
+                    crc = dcrc;
+                }
+
+            #endif
                 if (crc != dcrc) {
                     break;
                 }
 
+            #ifdef LFS_FETCH_CACHE
+                crcoff = off+sizeof(tag);
+                lastcrc = dcrc;
+
+            #endif
                 // reset the next bit if we need to
                 ptag ^= (lfs_tag_t)(lfs_tag_chunk(tag) & 1U) << 31;
 
@@ -1233,6 +1527,9 @@ static lfs_stag_t lfs_dir_fetchmatch(lfs_t *lfs,
             }
 
             // crc the entry first, hopefully leaving it in the cache
+        #ifdef LFS_FETCH_CACHE
+            if (!hit)
+        #endif
             err = lfs_bd_crc(lfs,
                     NULL, &lfs->rcache, lfs->cfg->block_size,
                     dir->pair[0], off+sizeof(tag),
@@ -1320,11 +1617,20 @@ static lfs_stag_t lfs_dir_fetchmatch(lfs_t *lfs,
             // try the other block?
             lfs_pair_swap(dir->pair);
             dir->rev = revs[(r+1)%2];
+        #ifdef LFS_FETCH_CACHE
+            hit = NULL;
+        #endif
             continue;
         }
 
         // did we end on a valid commit? we may have an erased block
         dir->erased = false;
+    #ifdef LFS_FETCH_CACHE
+        if (hit) {
+            // known from the fetch that filled the cache
+            dir->erased = hit->m.erased;
+        } else
+    #endif
         if (maybeerased && dir->off % lfs->cfg->prog_size == 0) {
         #ifdef LFS_MULTIVERSION
             // note versions < lfs2.1 did not have fcrc tags, if
@@ -1354,6 +1660,15 @@ static lfs_stag_t lfs_dir_fetchmatch(lfs_t *lfs,
             }
         }
 
+    #ifdef LFS_FETCH_CACHE
+        if (hit) {
+            lfs->cachestat.fetch_hits += 1;
+        } else {
+            lfs->cachestat.fetch_misses += 1;
+            lfs_fcache_store(lfs, dir, crcoff, lastcrc);
+        }
+
+    #endif
         // synthetic move
         if (lfs_gstate_hasmovehere(&lfs->gdisk, dir->pair)) {
             if (lfs_tag_id(lfs->gdisk.tag) == lfs_tag_id(besttag)) {
@@ -1393,6 +1708,19 @@ static int lfs_dir_fetch(lfs_t *lfs,
 
 static int lfs_dir_getgstate(lfs_t *lfs, const lfs_mdir_t *dir,
         lfs_gstate_t *gstate) {
+#ifdef LFS_FETCH_CACHE
+    // already found for this exact commit?
+    struct lfs_fcache_entry *e = lfs_fcache_lookup(lfs, dir);
+    if (e && (e->m.off != dir->off || e->m.etag != dir->etag)) {
+        e = NULL;
+    }
+
+    if (e && e->hasgdelta) {
+        lfs_gstate_xor(gstate, &e->gdelta);
+        return 0;
+    }
+#endif
+
     lfs_gstate_t temp;
     lfs_stag_t res = lfs_dir_get(lfs, dir, LFS_MKTAG(0x7ff, 0, 0),
             LFS_MKTAG(LFS_TYPE_MOVESTATE, 0, sizeof(temp)), &temp);
@@ -1406,6 +1734,16 @@ static int lfs_dir_getgstate(lfs_t *lfs, const lfs_mdir_t *dir,
         lfs_gstate_xor(gstate, &temp);
     }
 
+#ifdef LFS_FETCH_CACHE
+    if (e) {
+        if (res == LFS_ERR_NOENT) {
+            memset(&temp, 0, sizeof(temp));
+        }
+        e->gdelta = temp;
+        e->hasgdelta = true;
+    }
+#endif
+
     return 0;
 }
 
@@ -1473,6 +1811,46 @@ static int lfs_dir_find_match(void *data,
     return LFS_CMP_EQ;
 }
 
+#ifdef LFS_DENTRY_CACHE
+// the path lookup cache remembers the pair and tag whole paths resolved to,
+// keyed by the crc of the path, any commit that could move or rename an
+// entry forgets every path (see lfs_dcache_drop)
+static inline char *lfs_dcache_path(lfs_t *lfs,
+        const struct lfs_dcache_entry *e) {
+    return &lfs->dcache.path[(e - lfs->dcache.entry)*LFS_DENTRY_PATH_MAX];
+}
+
+// find the entry of path, or the least recently used entry to replace,
+// a linear scan since there are at most LFS_DENTRY_CACHE_MAX entries
+static struct lfs_dcache_entry *lfs_dcache_lookup(lfs_t *lfs,
+        const char *path, lfs_size_t len, uint32_t hash, bool *hit) {
+    struct lfs_dcache_entry *lru = &lfs->dcache.entry[0];
+    for (lfs_size_t i = 0; i < lfs->dcache.count; i++) {
+        struct lfs_dcache_entry *e = &lfs->dcache.entry[i];
+        if (e->len == len && e->hash == hash
+                && memcmp(lfs_dcache_path(lfs, e), path, len) == 0) {
+            *hit = true;
+            return e;
+        }
+
+        if (lfs->dcache.tick - e->used > lfs->dcache.tick - lru->used) {
+            lru = e;
+        }
+    }
+
+    *hit = false;
+    return lru;
+}
+
+#ifndef LFS_READONLY
+static void lfs_dcache_drop(lfs_t *lfs) {
+    for (lfs_size_t i = 0; i < lfs->dcache.count; i++) {
+        lfs->dcache.entry[i].len = 0;
+    }
+}
+#endif
+#endif
+
 // lfs_dir_find tries to set path and id even if file is not found
 //
 // returns:
@@ -1494,6 +1872,39 @@ static lfs_stag_t lfs_dir_find(lfs_t *lfs, lfs_mdir_t *dir,
         return LFS_ERR_INVAL;
     }
 
+#ifdef LFS_DENTRY_CACHE
+    // resolved this exact path before?
+    struct lfs_dcache_entry *dent = NULL;
+    lfs_size_t pathlen = (lfs->dcache.count) ? strlen(name) : 0;
+    if (lfs->dcache.count && pathlen <= LFS_DENTRY_PATH_MAX) {
+        uint32_t hash = lfs_crc(0xffffffff, name, pathlen);
+        bool hit;
+        dent = lfs_dcache_lookup(lfs, name, pathlen, hash, &hit);
+        lfs->dcache.tick += 1;
+        dent->used = lfs->dcache.tick;
+        if (hit) {
+            int err = lfs_dir_fetch(lfs, dir, dent->pair);
+            if (err) {
+                return err;
+            }
+
+            if (id) {
+                *id = lfs_tag_id(dent->tag);
+            }
+            *path = name + dent->nameoff;
+            lfs->cachestat.dentry_hits += 1;
+            return dent->tag;
+        }
+
+        // the replaced entry stays invalid until the walk finds the path
+        lfs->cachestat.dentry_misses += 1;
+        dent->len = 0;
+        dent->hash = hash;
+        memcpy(lfs_dcache_path(lfs, dent), name, pathlen);
+    }
+    const char *start = name;
+#endif
+
     while (true) {
 nextname:
         // skip slashes if we're a directory
@@ -1541,6 +1952,16 @@ nextname:
 
         // found path
         if (*name == '\0') {
+        #ifdef LFS_DENTRY_CACHE
+            // remember where it resolved, the root has no entry to find
+            if (dent && lfs_tag_id(tag) != 0x3ff) {
+                dent->pair[0] = dir->pair[0];
+                dent->pair[1] = dir->pair[1];
+                dent->tag = tag;
+                dent->len = pathlen;
+                dent->nameoff = *path - start;
+            }
+        #endif
             return tag;
         }
 
@@ -1879,6 +2300,11 @@ static int lfs_dir_drop(lfs_t *lfs, lfs_mdir_t *dir, lfs_mdir_t *tail) {
 static int lfs_dir_split(lfs_t *lfs,
         lfs_mdir_t *dir, const struct lfs_mattr *attrs, int attrcount,
         lfs_mdir_t *source, uint16_t split, uint16_t end) {
+#ifdef LFS_DENTRY_CACHE
+    // entries from split to end are about to move to the new pair
+    lfs_dcache_drop(lfs);
+#endif
+
     // create tail metadata pair
     lfs_mdir_t tail;
     int err = lfs_dir_alloc(lfs, &tail);
@@ -1891,7 +2317,9 @@ static int lfs_dir_split(lfs_t *lfs,
     tail.tail[1] = dir->tail[1];
 
     // note we don't care about LFS_OK_RELOCATED
+    LFS_PROFILE_ENTER(LFS_PROFILE_DIR_COMPACT);
     int res = lfs_dir_compact(lfs, &tail, attrs, attrcount, source, split, end);
+    LFS_PROFILE_LEAVE();
     if (res < 0) {
         return res;
     }
@@ -2095,6 +2523,9 @@ relocate:
         // commit was corrupted, drop caches and prepare to relocate block
         relocated = true;
         lfs_cache_drop(lfs, &lfs->pcache);
+    #ifdef LFS_DENTRY_CACHE
+        lfs_dcache_drop(lfs);
+    #endif
         if (!tired) {
             LFS_DEBUG("Bad block at 0x%"PRIx32, dir->pair[1]);
         }
@@ -2225,7 +2656,10 @@ static int lfs_dir_splittingcompact(lfs_t *lfs, lfs_mdir_t *dir,
         }
     }
 
-    return lfs_dir_compact(lfs, dir, attrs, attrcount, source, begin, end);
+    LFS_PROFILE_ENTER(LFS_PROFILE_DIR_COMPACT);
+    int err = lfs_dir_compact(lfs, dir, attrs, attrcount, source, begin, end);
+    LFS_PROFILE_LEAVE();
+    return err;
 }
 #endif
 
@@ -2239,6 +2673,17 @@ static int lfs_dir_relocatingcommit(lfs_t *lfs, lfs_mdir_t *dir,
     // calculate changes to the directory
     bool hasdelete = false;
     for (int i = 0; i < attrcount; i++) {
+    #ifdef LFS_DENTRY_CACHE
+        // entries appear, disappear, shift ids or move to other pairs,
+        // forget every resolved path
+        if (lfs_tag_type3(attrs[i].tag) == LFS_TYPE_CREATE
+                || lfs_tag_type3(attrs[i].tag) == LFS_TYPE_DELETE
+                || lfs_tag_type3(attrs[i].tag) == LFS_TYPE_DIRSTRUCT
+                || lfs_tag_type1(attrs[i].tag) == LFS_TYPE_TAIL) {
+            lfs_dcache_drop(lfs);
+        }
+    #endif
+
         if (lfs_tag_type3(attrs[i].tag) == LFS_TYPE_CREATE) {
             dir->count += 1;
         } else if (lfs_tag_type3(attrs[i].tag) == LFS_TYPE_DELETE) {
@@ -2882,10 +3327,45 @@ static int lfs_ctz_index(lfs_t *lfs, lfs_off_t *off) {
     return i;
 }
 
+#ifdef LFS_CTZ_CACHE
+// the optional per-file position cache, the first half of the entries keeps
+// one checkpoint per stride of the list, the rest the last resolved positions
+//
+// any block of a skip-list leads to every block before it, so the list below
+// a remembered block holds as long as the file's ctz doesn't change
+static void lfs_ctzcache_drop(struct lfs_ctzcache *ctzc) {
+    for (lfs_size_t i = 0; i < ctzc->count; i++) {
+        ctzc->pos[i].block = LFS_BLOCK_NULL;
+    }
+    ctzc->next = 0;
+}
+
+// number of pointers lfs_ctz_find follows from index current to target,
+// blocks at unaligned indices only skip to their neighbour
+static lfs_size_t lfs_ctz_hops(lfs_off_t current, lfs_off_t target) {
+    lfs_size_t hops = 0;
+    while (current > target) {
+        current -= 1 << lfs_min(
+                lfs_npw2(current-target+1) - 1,
+                lfs_ctz(current));
+        hops += 1;
+    }
+
+    return hops;
+}
+
+#define LFS_CTZCACHE(file) (&(file)->ctzc)
+#else
+// without position caches every walk starts from the head
+struct lfs_ctzcache;
+#define LFS_CTZCACHE(file) NULL
+#endif
+
 static int lfs_ctz_find(lfs_t *lfs,
         const lfs_cache_t *pcache, lfs_cache_t *rcache,
         lfs_block_t head, lfs_size_t size,
-        lfs_size_t pos, lfs_block_t *block, lfs_off_t *off) {
+        lfs_size_t pos, lfs_block_t *block, lfs_off_t *off,
+        struct lfs_ctzcache *ctzc) {
     if (size == 0) {
         *block = LFS_BLOCK_NULL;
         *off = 0;
@@ -2895,6 +3375,38 @@ static int lfs_ctz_find(lfs_t *lfs,
     lfs_off_t current = lfs_ctz_index(lfs, &(lfs_off_t){size-1});
     lfs_off_t target = lfs_ctz_index(lfs, &pos);
 
+#ifdef LFS_CTZ_CACHE
+    // start from the remembered block at or after target with the shortest
+    // walk, if it beats walking from the head
+    lfs_size_t checks = 0;
+    lfs_off_t stride = 0;
+    struct lfs_ctzpos *start = NULL;
+    if (ctzc && ctzc->count) {
+        checks = ctzc->count / 2;
+        stride = current / lfs_max(checks, 1) + 1;
+        lfs_size_t hops = lfs_ctz_hops(current, target);
+        for (lfs_size_t i = 0; i < ctzc->count && hops > 0; i++) {
+            struct lfs_ctzpos *p = &ctzc->pos[i];
+            if (p->block != LFS_BLOCK_NULL && p->index >= target
+                    && p->index <= current
+                    && lfs_ctz_hops(p->index, target) < hops) {
+                start = p;
+                hops = lfs_ctz_hops(p->index, target);
+            }
+        }
+
+        if (start) {
+            head = start->block;
+            current = start->index;
+            lfs->cachestat.ctz_hits += 1;
+        } else {
+            lfs->cachestat.ctz_misses += 1;
+        }
+    }
+#else
+    (void)ctzc;
+#endif
+
     while (current > target) {
         lfs_size_t skip = lfs_min(
                 lfs_npw2(current-target+1) - 1,
@@ -2909,8 +3421,29 @@ static int lfs_ctz_find(lfs_t *lfs,
         }
 
         current -= 1 << skip;
+
+    #ifdef LFS_CTZ_CACHE
+        // keep the last block of each stride we pass through as checkpoint
+        if (checks) {
+            struct lfs_ctzpos *p = &ctzc->pos[current / stride];
+            if (p->block == LFS_BLOCK_NULL || p->index < current) {
+                p->index = current;
+                p->block = head;
+            }
+        }
+    #endif
     }
 
+#ifdef LFS_CTZ_CACHE
+    // remember where target lives
+    if (ctzc && ctzc->count > checks && !(start && start->index == target)) {
+        struct lfs_ctzpos *p = &ctzc->pos[checks + ctzc->next];
+        p->index = target;
+        p->block = head;
+        ctzc->next = (ctzc->next + 1) % (ctzc->count - checks);
+    }
+#endif
+
     *block = head;
     *off = pos;
     return 0;
@@ -3083,6 +3616,10 @@ static int lfs_file_opencfg_(lfs_t *lfs, lfs_file_t *file,
     file->pos = 0;
     file->off = 0;
     file->cache.buffer = NULL;
+#ifdef LFS_CTZ_CACHE
+    file->ctzc.pos = NULL;
+    file->ctzc.count = 0;
+#endif
 
     // allocate entry for file if it doesn't exist
     lfs_stag_t tag = lfs_dir_find(lfs, &file->m, &path, &file->id);
@@ -3199,6 +3736,25 @@ static int lfs_file_opencfg_(lfs_t *lfs, lfs_file_t *file,
     // zero to avoid information leak
     lfs_cache_zero(lfs, &file->cache);
 
+#ifdef LFS_CTZ_CACHE
+    // allocate position cache if requested
+    if (file->cfg->ctz_cache_count) {
+        if (file->cfg->ctz_cache) {
+            file->ctzc.pos = file->cfg->ctz_cache;
+        } else {
+            file->ctzc.pos = lfs_malloc(
+                    file->cfg->ctz_cache_count*sizeof(struct lfs_ctzpos));
+            if (!file->ctzc.pos) {
+                err = LFS_ERR_NOMEM;
+                goto cleanup;
+            }
+        }
+
+        file->ctzc.count = file->cfg->ctz_cache_count;
+    }
+    lfs_ctzcache_drop(&file->ctzc);
+#endif
+
     if (lfs_tag_type3(tag) == LFS_TYPE_INLINESTRUCT) {
         // load inline files
         file->ctz.head = LFS_BLOCK_INLINE;
@@ -3257,6 +3813,12 @@ static int lfs_file_close_(lfs_t *lfs, lfs_file_t *file) {
         lfs_free(file->cache.buffer);
     }
 
+#ifdef LFS_CTZ_CACHE
+    if (file->ctzc.count && !file->cfg->ctz_cache) {
+        lfs_free(file->ctzc.pos);
+    }
+#endif
+
     return err;
 }
 
@@ -3416,6 +3978,9 @@ relocate:
         // actual file updates
         file->ctz.head = file->block;
         file->ctz.size = file->pos;
+    #ifdef LFS_CTZ_CACHE
+        lfs_ctzcache_drop(&file->ctzc);
+    #endif
         file->flags &= ~LFS_F_WRITING;
         file->flags |= LFS_F_DIRTY;
 
@@ -3508,7 +4073,8 @@ static lfs_ssize_t lfs_file_flushedread(lfs_t *lfs, lfs_file_t *file,
             if (!(file->flags & LFS_F_INLINE)) {
                 int err = lfs_ctz_find(lfs, NULL, &file->cache,
                         file->ctz.head, file->ctz.size,
-                        file->pos, &file->block, &file->off);
+                        file->pos, &file->block, &file->off,
+                        LFS_CTZCACHE(file));
                 if (err) {
                     return err;
                 }
@@ -3592,7 +4158,8 @@ static lfs_ssize_t lfs_file_flushedwrite(lfs_t *lfs, lfs_file_t *file,
                     // find out which block we're extending from
                     int err = lfs_ctz_find(lfs, NULL, &file->cache,
                             file->ctz.head, file->ctz.size,
-                            file->pos-1, &file->block, &(lfs_off_t){0});
+                            file->pos-1, &file->block, &(lfs_off_t){0},
+                            LFS_CTZCACHE(file));
                     if (err) {
                         file->flags |= LFS_F_ERRED;
                         return err;
@@ -3793,7 +4360,8 @@ static int lfs_file_truncate_(lfs_t *lfs, lfs_file_t *file, lfs_off_t size) {
             // lookup new head in ctz skip list
             err = lfs_ctz_find(lfs, NULL, &file->cache,
                     file->ctz.head, file->ctz.size,
-                    size-1, &file->block, &(lfs_off_t){0});
+                    size-1, &file->block, &(lfs_off_t){0},
+                    LFS_CTZCACHE(file));
             if (err) {
                 return err;
             }
@@ -3803,6 +4371,9 @@ static int lfs_file_truncate_(lfs_t *lfs, lfs_file_t *file, lfs_off_t size) {
             file->pos = size;
             file->ctz.head = file->block;
             file->ctz.size = size;
+        #ifdef LFS_CTZ_CACHE
+            lfs_ctzcache_drop(&file->ctzc);
+        #endif
             file->flags |= LFS_F_DIRTY | LFS_F_READING;
         }
     } else if (size > oldsize) {
@@ -3857,6 +4428,62 @@ static lfs_soff_t lfs_file_size_(lfs_t *lfs, lfs_file_t *file) {
     return file->ctz.size;
 }
 
+static int lfs_file_spans_(lfs_t *lfs, lfs_file_t *file,
+        int (*cb)(void *data, lfs_off_t pos,
+            lfs_block_t block, lfs_off_t off, lfs_size_t size),
+        void *data) {
+#ifndef LFS_READONLY
+    if (file->flags & LFS_F_WRITING) {
+        // flush out any writes so the skip-list is on disk
+        int err = lfs_file_flush(lfs, file);
+        if (err) {
+            return err;
+        }
+    }
+#endif
+
+    if (file->flags & LFS_F_INLINE) {
+        // inlined data lives in the metadata log, not in its own blocks
+        return LFS_ERR_INVAL;
+    }
+
+    if (file->ctz.size == 0) {
+        return 0;
+    }
+
+    // walk the skip-list once from the head, following the first
+    // pointer of each block back to its predecessor
+    lfs_block_t head = file->ctz.head;
+    lfs_off_t end = file->ctz.size - 1;
+    lfs_off_t index = lfs_ctz_index(lfs, &end);
+    end += 1;
+
+    while (true) {
+        lfs_off_t start = (index == 0) ? 0 : 4*(lfs_ctz(index)+1);
+        lfs_off_t pos = (lfs->cfg->block_size - 2*4)*index
+                + 4*lfs_popc(index) + start;
+        int err = cb(data, pos, head, start, end - start);
+        if (err) {
+            return err;
+        }
+
+        if (index == 0) {
+            return 0;
+        }
+
+        err = lfs_bd_read(lfs,
+                NULL, &lfs->rcache, sizeof(head),
+                head, 0, &head, sizeof(head));
+        head = lfs_fromle32(head);
+        if (err) {
+            return err;
+        }
+
+        index -= 1;
+        end = lfs->cfg->block_size;
+    }
+}
+
 
 /// General fs operations ///
 static int lfs_stat_(lfs_t *lfs, const char *path, struct lfs_info *info) {
@@ -4197,6 +4824,12 @@ static int lfs_removeattr_(lfs_t *lfs, const char *path, uint8_t type) {
 static int lfs_init(lfs_t *lfs, const struct lfs_config *cfg) {
     lfs->cfg = cfg;
     lfs->block_count = cfg->block_count;  // May be 0
+#ifdef LFS_READ_CACHE
+    lfs->rcaches.count = 0;
+#endif
+#ifdef LFS_DENTRY_CACHE
+    lfs->dcache.count = 0;
+#endif
     int err = 0;
 
 #ifdef LFS_MULTIVERSION
@@ -4293,6 +4926,69 @@ static int lfs_init(lfs_t *lfs, const struct lfs_config *cfg) {
     lfs_cache_zero(lfs, &lfs->rcache);
     lfs_cache_zero(lfs, &lfs->pcache);
 
+#ifdef LFS_READ_CACHE
+    // setup extra read caches
+    LFS_ASSERT(lfs->cfg->read_cache_count <= LFS_READ_CACHE_MAX);
+    if (lfs->cfg->read_cache_count) {
+        uint8_t *buffer = lfs->cfg->read_cache_buffer;
+        if (!buffer) {
+            buffer = lfs_malloc(
+                    lfs->cfg->read_cache_count*lfs->cfg->cache_size);
+            if (!buffer) {
+                err = LFS_ERR_NOMEM;
+                goto cleanup;
+            }
+        }
+
+        lfs->rcaches.count = lfs->cfg->read_cache_count;
+        for (lfs_size_t i = 0; i < lfs->rcaches.count; i++) {
+            lfs->rcaches.way[i].buffer = buffer + i*lfs->cfg->cache_size;
+            lfs_cache_zero(lfs, &lfs->rcaches.way[i]);
+        }
+    }
+    memset(lfs->rcaches.used, 0, sizeof(lfs->rcaches.used));
+    lfs->rcaches.tick = 0;
+#endif
+
+#ifdef LFS_FETCH_CACHE
+    // setup fetch cache
+    LFS_ASSERT(lfs->cfg->fetch_cache_count <= LFS_FETCH_CACHE_MAX);
+    lfs->fcache.count = lfs->cfg->fetch_cache_count;
+    lfs->fcache.tick = 0;
+    for (lfs_size_t i = 0; i < LFS_FETCH_CACHE_MAX; i++) {
+        lfs->fcache.entry[i].m.pair[0] = LFS_BLOCK_NULL;
+        lfs->fcache.entry[i].m.pair[1] = LFS_BLOCK_NULL;
+        lfs->fcache.entry[i].used = 0;
+    }
+#endif
+
+#ifdef LFS_DENTRY_CACHE
+    // setup path lookup cache
+    LFS_ASSERT(lfs->cfg->dentry_cache_count <= LFS_DENTRY_CACHE_MAX);
+    if (lfs->cfg->dentry_cache_count) {
+        if (lfs->cfg->dentry_cache_buffer) {
+            lfs->dcache.path = lfs->cfg->dentry_cache_buffer;
+        } else {
+            lfs->dcache.path = lfs_malloc(
+                    lfs->cfg->dentry_cache_count*LFS_DENTRY_PATH_MAX);
+            if (!lfs->dcache.path) {
+                err = LFS_ERR_NOMEM;
+                goto cleanup;
+            }
+        }
+
+        lfs->dcache.count = lfs->cfg->dentry_cache_count;
+    }
+    lfs->dcache.tick = 0;
+    for (lfs_size_t i = 0; i < LFS_DENTRY_CACHE_MAX; i++) {
+        lfs->dcache.entry[i].len = 0;
+        lfs->dcache.entry[i].used = 0;
+    }
+#endif
+#ifdef LFS_CACHESTAT
+    memset(&lfs->cachestat, 0, sizeof(lfs->cachestat));
+#endif
+
     // setup lookahead buffer, note mount finishes initializing this after
     // we establish a decent pseudo-random seed
     LFS_ASSERT(lfs->cfg->lookahead_size > 0);
@@ -4381,6 +5077,18 @@ static int lfs_deinit(lfs_t *lfs) {
         lfs_free(lfs->lookahead.buffer);
     }
 
+#ifdef LFS_READ_CACHE
+    if (lfs->rcaches.count && !lfs->cfg->read_cache_buffer) {
+        lfs_free(lfs->rcaches.way[0].buffer);
+    }
+#endif
+
+#ifdef LFS_DENTRY_CACHE
+    if (lfs->dcache.count && !lfs->cfg->dentry_cache_buffer) {
+        lfs_free(lfs->dcache.path);
+    }
+#endif
+
     return 0;
 }
 
@@ -4689,6 +5397,13 @@ static int lfs_fs_stat_(lfs_t *lfs, struct lfs_fsinfo *fsinfo) {
     return 0;
 }
 
+#ifdef LFS_CACHESTAT
+static int lfs_fs_cachestat_(lfs_t *lfs, struct lfs_cachestat *cachestat) {
+    *cachestat = lfs->cachestat;
+    return 0;
+}
+#endif
+
 int lfs_fs_traverse_(lfs_t *lfs,
         int (*cb)(void *data, lfs_block_t block), void *data,
         bool includeorphans) {
@@ -5987,7 +6702,9 @@ int lfs_format(lfs_t *lfs, const struct lfs_config *cfg) {
             cfg->read_buffer, cfg->prog_buffer, cfg->lookahead_buffer,
             cfg->name_max, cfg->file_max, cfg->attr_max);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FORMAT);
     err = lfs_format_(lfs, cfg);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_format -> %d", err);
     LFS_UNLOCK(cfg);
@@ -6017,7 +6734,9 @@ int lfs_mount(lfs_t *lfs, const struct lfs_config *cfg) {
             cfg->read_buffer, cfg->prog_buffer, cfg->lookahead_buffer,
             cfg->name_max, cfg->file_max, cfg->attr_max);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_MOUNT);
     err = lfs_mount_(lfs, cfg);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_mount -> %d", err);
     LFS_UNLOCK(cfg);
@@ -6031,7 +6750,9 @@ int lfs_unmount(lfs_t *lfs) {
     }
     LFS_TRACE("lfs_unmount(%p)", (void*)lfs);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_UNMOUNT);
     err = lfs_unmount_(lfs);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_unmount -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6046,7 +6767,9 @@ int lfs_remove(lfs_t *lfs, const char *path) {
     }
     LFS_TRACE("lfs_remove(%p, \"%s\")", (void*)lfs, path);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_REMOVE);
     err = lfs_remove_(lfs, path);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_remove -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6062,7 +6785,9 @@ int lfs_rename(lfs_t *lfs, const char *oldpath, const char *newpath) {
     }
     LFS_TRACE("lfs_rename(%p, \"%s\", \"%s\")", (void*)lfs, oldpath, newpath);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_RENAME);
     err = lfs_rename_(lfs, oldpath, newpath);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_rename -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6077,7 +6802,9 @@ int lfs_stat(lfs_t *lfs, const char *path, struct lfs_info *info) {
     }
     LFS_TRACE("lfs_stat(%p, \"%s\", %p)", (void*)lfs, path, (void*)info);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_STAT);
     err = lfs_stat_(lfs, path, info);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_stat -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6093,7 +6820,9 @@ lfs_ssize_t lfs_getattr(lfs_t *lfs, const char *path,
     LFS_TRACE("lfs_getattr(%p, \"%s\", %"PRIu8", %p, %"PRIu32")",
             (void*)lfs, path, type, buffer, size);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_GETATTR);
     lfs_ssize_t res = lfs_getattr_(lfs, path, type, buffer, size);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_getattr -> %"PRId32, res);
     LFS_UNLOCK(lfs->cfg);
@@ -6110,7 +6839,9 @@ int lfs_setattr(lfs_t *lfs, const char *path,
     LFS_TRACE("lfs_setattr(%p, \"%s\", %"PRIu8", %p, %"PRIu32")",
             (void*)lfs, path, type, buffer, size);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_SETATTR);
     err = lfs_setattr_(lfs, path, type, buffer, size);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_setattr -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6126,7 +6857,9 @@ int lfs_removeattr(lfs_t *lfs, const char *path, uint8_t type) {
     }
     LFS_TRACE("lfs_removeattr(%p, \"%s\", %"PRIu8")", (void*)lfs, path, type);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_REMOVEATTR);
     err = lfs_removeattr_(lfs, path, type);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_removeattr -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6144,7 +6877,9 @@ int lfs_file_open(lfs_t *lfs, lfs_file_t *file, const char *path, int flags) {
             (void*)lfs, (void*)file, path, (unsigned)flags);
     LFS_ASSERT(!lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FILE_OPEN);
     err = lfs_file_open_(lfs, file, path, flags);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_file_open -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6165,7 +6900,9 @@ int lfs_file_opencfg(lfs_t *lfs, lfs_file_t *file,
             (void*)cfg, cfg->buffer, (void*)cfg->attrs, cfg->attr_count);
     LFS_ASSERT(!lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FILE_OPENCFG);
     err = lfs_file_opencfg_(lfs, file, path, flags, cfg);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_file_opencfg -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6180,7 +6917,9 @@ int lfs_file_close(lfs_t *lfs, lfs_file_t *file) {
     LFS_TRACE("lfs_file_close(%p, %p)", (void*)lfs, (void*)file);
     LFS_ASSERT(lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FILE_CLOSE);
     err = lfs_file_close_(lfs, file);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_file_close -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6196,7 +6935,9 @@ int lfs_file_sync(lfs_t *lfs, lfs_file_t *file) {
     LFS_TRACE("lfs_file_sync(%p, %p)", (void*)lfs, (void*)file);
     LFS_ASSERT(lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FILE_SYNC);
     err = lfs_file_sync_(lfs, file);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_file_sync -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6214,7 +6955,9 @@ lfs_ssize_t lfs_file_read(lfs_t *lfs, lfs_file_t *file,
             (void*)lfs, (void*)file, buffer, size);
     LFS_ASSERT(lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FILE_READ);
     lfs_ssize_t res = lfs_file_read_(lfs, file, buffer, size);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_file_read -> %"PRId32, res);
     LFS_UNLOCK(lfs->cfg);
@@ -6232,7 +6975,9 @@ lfs_ssize_t lfs_file_write(lfs_t *lfs, lfs_file_t *file,
             (void*)lfs, (void*)file, buffer, size);
     LFS_ASSERT(lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FILE_WRITE);
     lfs_ssize_t res = lfs_file_write_(lfs, file, buffer, size);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_file_write -> %"PRId32, res);
     LFS_UNLOCK(lfs->cfg);
@@ -6250,7 +6995,9 @@ lfs_soff_t lfs_file_seek(lfs_t *lfs, lfs_file_t *file,
             (void*)lfs, (void*)file, off, whence);
     LFS_ASSERT(lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FILE_SEEK);
     lfs_soff_t res = lfs_file_seek_(lfs, file, off, whence);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_file_seek -> %"PRId32, res);
     LFS_UNLOCK(lfs->cfg);
@@ -6267,7 +7014,9 @@ int lfs_file_truncate(lfs_t *lfs, lfs_file_t *file, lfs_off_t size) {
             (void*)lfs, (void*)file, size);
     LFS_ASSERT(lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FILE_TRUNCATE);
     err = lfs_file_truncate_(lfs, file, size);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_file_truncate -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6283,7 +7032,9 @@ lfs_soff_t lfs_file_tell(lfs_t *lfs, lfs_file_t *file) {
     LFS_TRACE("lfs_file_tell(%p, %p)", (void*)lfs, (void*)file);
     LFS_ASSERT(lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FILE_TELL);
     lfs_soff_t res = lfs_file_tell_(lfs, file);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_file_tell -> %"PRId32, res);
     LFS_UNLOCK(lfs->cfg);
@@ -6297,7 +7048,9 @@ int lfs_file_rewind(lfs_t *lfs, lfs_file_t *file) {
     }
     LFS_TRACE("lfs_file_rewind(%p, %p)", (void*)lfs, (void*)file);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FILE_REWIND);
     err = lfs_file_rewind_(lfs, file);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_file_rewind -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6312,13 +7065,36 @@ lfs_soff_t lfs_file_size(lfs_t *lfs, lfs_file_t *file) {
     LFS_TRACE("lfs_file_size(%p, %p)", (void*)lfs, (void*)file);
     LFS_ASSERT(lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FILE_SIZE);
     lfs_soff_t res = lfs_file_size_(lfs, file);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_file_size -> %"PRIu32, res);
     LFS_UNLOCK(lfs->cfg);
     return res;
 }
 
+int lfs_file_spans(lfs_t *lfs, lfs_file_t *file,
+        int (*cb)(void *data, lfs_off_t pos,
+            lfs_block_t block, lfs_off_t off, lfs_size_t size),
+        void *data) {
+    int err = LFS_LOCK(lfs->cfg);
+    if (err) {
+        return err;
+    }
+    LFS_TRACE("lfs_file_spans(%p, %p, %p, %p)",
+            (void*)lfs, (void*)file, (void*)(uintptr_t)cb, data);
+    LFS_ASSERT(lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
+
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FILE_SPANS);
+    err = lfs_file_spans_(lfs, file, cb, data);
+    LFS_PROFILE_END();
+
+    LFS_TRACE("lfs_file_spans -> %d", err);
+    LFS_UNLOCK(lfs->cfg);
+    return err;
+}
+
 #ifndef LFS_READONLY
 int lfs_mkdir(lfs_t *lfs, const char *path) {
     int err = LFS_LOCK(lfs->cfg);
@@ -6327,7 +7103,9 @@ int lfs_mkdir(lfs_t *lfs, const char *path) {
     }
     LFS_TRACE("lfs_mkdir(%p, \"%s\")", (void*)lfs, path);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_MKDIR);
     err = lfs_mkdir_(lfs, path);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_mkdir -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6343,7 +7121,9 @@ int lfs_dir_open(lfs_t *lfs, lfs_dir_t *dir, const char *path) {
     LFS_TRACE("lfs_dir_open(%p, %p, \"%s\")", (void*)lfs, (void*)dir, path);
     LFS_ASSERT(!lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)dir));
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_DIR_OPEN);
     err = lfs_dir_open_(lfs, dir, path);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_dir_open -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6357,7 +7137,9 @@ int lfs_dir_close(lfs_t *lfs, lfs_dir_t *dir) {
     }
     LFS_TRACE("lfs_dir_close(%p, %p)", (void*)lfs, (void*)dir);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_DIR_CLOSE);
     err = lfs_dir_close_(lfs, dir);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_dir_close -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6372,7 +7154,9 @@ int lfs_dir_read(lfs_t *lfs, lfs_dir_t *dir, struct lfs_info *info) {
     LFS_TRACE("lfs_dir_read(%p, %p, %p)",
             (void*)lfs, (void*)dir, (void*)info);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_DIR_READ);
     err = lfs_dir_read_(lfs, dir, info);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_dir_read -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6387,7 +7171,9 @@ int lfs_dir_seek(lfs_t *lfs, lfs_dir_t *dir, lfs_off_t off) {
     LFS_TRACE("lfs_dir_seek(%p, %p, %"PRIu32")",
             (void*)lfs, (void*)dir, off);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_DIR_SEEK);
     err = lfs_dir_seek_(lfs, dir, off);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_dir_seek -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6401,7 +7187,9 @@ lfs_soff_t lfs_dir_tell(lfs_t *lfs, lfs_dir_t *dir) {
     }
     LFS_TRACE("lfs_dir_tell(%p, %p)", (void*)lfs, (void*)dir);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_DIR_TELL);
     lfs_soff_t res = lfs_dir_tell_(lfs, dir);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_dir_tell -> %"PRId32, res);
     LFS_UNLOCK(lfs->cfg);
@@ -6415,7 +7203,9 @@ int lfs_dir_rewind(lfs_t *lfs, lfs_dir_t *dir) {
     }
     LFS_TRACE("lfs_dir_rewind(%p, %p)", (void*)lfs, (void*)dir);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_DIR_REWIND);
     err = lfs_dir_rewind_(lfs, dir);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_dir_rewind -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6429,7 +7219,9 @@ int lfs_fs_stat(lfs_t *lfs, struct lfs_fsinfo *fsinfo) {
     }
     LFS_TRACE("lfs_fs_stat(%p, %p)", (void*)lfs, (void*)fsinfo);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FS_STAT);
     err = lfs_fs_stat_(lfs, fsinfo);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_fs_stat -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6443,7 +7235,9 @@ lfs_ssize_t lfs_fs_size(lfs_t *lfs) {
     }
     LFS_TRACE("lfs_fs_size(%p)", (void*)lfs);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FS_SIZE);
     lfs_ssize_t res = lfs_fs_size_(lfs);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_fs_size -> %"PRId32, res);
     LFS_UNLOCK(lfs->cfg);
@@ -6458,7 +7252,9 @@ int lfs_fs_traverse(lfs_t *lfs, int (*cb)(void *, lfs_block_t), void *data) {
     LFS_TRACE("lfs_fs_traverse(%p, %p, %p)",
             (void*)lfs, (void*)(uintptr_t)cb, data);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FS_TRAVERSE);
     err = lfs_fs_traverse_(lfs, cb, data, true);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_fs_traverse -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6473,7 +7269,9 @@ int lfs_fs_mkconsistent(lfs_t *lfs) {
     }
     LFS_TRACE("lfs_fs_mkconsistent(%p)", (void*)lfs);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FS_MKCONSISTENT);
     err = lfs_fs_mkconsistent_(lfs);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_fs_mkconsistent -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6489,7 +7287,9 @@ int lfs_fs_gc(lfs_t *lfs) {
     }
     LFS_TRACE("lfs_fs_gc(%p)", (void*)lfs);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FS_GC);
     err = lfs_fs_gc_(lfs);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_fs_gc -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6505,7 +7305,9 @@ int lfs_fs_grow(lfs_t *lfs, lfs_size_t block_count) {
     }
     LFS_TRACE("lfs_fs_grow(%p, %"PRIu32")", (void*)lfs, block_count);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FS_GROW);
     err = lfs_fs_grow_(lfs, block_count);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_fs_grow -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -6536,7 +7338,9 @@ int lfs_migrate(lfs_t *lfs, const struct lfs_config *cfg) {
             cfg->read_buffer, cfg->prog_buffer, cfg->lookahead_buffer,
             cfg->name_max, cfg->file_max, cfg->attr_max);
 
+    LFS_PROFILE_BEGIN(LFS_PROFILE_MIGRATE);
     err = lfs_migrate_(lfs, cfg);
+    LFS_PROFILE_END();
 
     LFS_TRACE("lfs_migrate -> %d", err);
     LFS_UNLOCK(cfg);
@@ -6544,3 +7348,55 @@ int lfs_migrate(lfs_t *lfs, const struct lfs_config *cfg) {
 }
 #endif
 
+#ifdef LFS_CACHESTAT
+int lfs_fs_cachestat(lfs_t *lfs, struct lfs_cachestat *cachestat) {
+    int err = LFS_LOCK(lfs->cfg);
+    if (err) {
+        return err;
+    }
+    LFS_TRACE("lfs_fs_cachestat(%p, %p)", (void*)lfs, (void*)cachestat);
+
+    LFS_PROFILE_BEGIN(LFS_PROFILE_FS_CACHESTAT);
+    err = lfs_fs_cachestat_(lfs, cachestat);
+    LFS_PROFILE_END();
+
+    LFS_TRACE("lfs_fs_cachestat -> %d", err);
+    LFS_UNLOCK(lfs->cfg);
+    return err;
+}
+#endif
+
+#ifdef LFS_PROFILE
+const struct lfs_profile_call_stats *lfs_profile_get(
+        enum lfs_profile_call call) {
+    LFS_ASSERT(call < LFS_PROFILE_CALL_COUNT);
+    return &lfs_profile_calls[call];
+}
+
+const char *lfs_profile_call_name(enum lfs_profile_call call) {
+    static const char *const names[LFS_PROFILE_CALL_COUNT] = {
+        "format", "mount", "unmount", "remove", "rename", "stat",
+        "getattr", "setattr", "removeattr", "file_open", "file_opencfg",
+        "file_close", "file_sync", "file_read", "file_write", "file_seek",
+        "file_truncate", "file_tell", "file_rewind", "file_size",
+        "file_spans", "mkdir", "dir_open", "dir_close", "dir_read",
+        "dir_seek", "dir_tell", "dir_rewind", "fs_stat", "fs_size",
+        "fs_traverse", "fs_mkconsistent", "fs_gc", "fs_grow", "migrate",
+    #ifdef LFS_CACHESTAT
+        "fs_cachestat",
+    #endif
+    };
+    return (call < LFS_PROFILE_CALL_COUNT) ? names[call] : "?";
+}
+
+const char *lfs_profile_phase_name(enum lfs_profile_phase phase) {
+    static const char *const names[LFS_PROFILE_PHASE_COUNT] = {
+        "dir_compact", "alloc_scan", "bd_erase", "bd_flush",
+    };
+    return (phase < LFS_PROFILE_PHASE_COUNT) ? names[phase] : "?";
+}
+
+void lfs_profile_reset(void) {
+    memset(lfs_profile_calls, 0, sizeof(lfs_profile_calls));
+}
+#endif
@@ -0,0 +1,181 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : FalLog.cpp
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : Compile-time levelled logging and binary trace ring buffer for the FAL
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : nucleo_f401re
+ * @compiler : gcc-arm-none-eabi
+ *
+ **************************************************************************************************
+ *
+ */
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Includes                                                                                      */
+/*-----------------------------------------------------------------------------------------------*/
+#include <stdarg.h>
+#include <stdio.h>
+#include "FalLog.h"
+#if defined(ARDUINO)
+  #include <Arduino.h>
+#else
+  #include <time.h>
+#endif
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Defines                                                                               */
+/*-----------------------------------------------------------------------------------------------*/
+#define FAL_LOG_LINE_MAX (128U)   // Longest formatted log line, longer lines are truncated
+
+#if defined(ARDUINO)
+  #define FAL_TRACE_LOCK()   uint32_t primask = __get_PRIMASK(); __disable_irq()
+  #define FAL_TRACE_UNLOCK() __set_PRIMASK(primask)
+#else
+  #define FAL_TRACE_LOCK()   do {} while (0)
+  #define FAL_TRACE_UNLOCK() do {} while (0)
+#endif
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Variables                                                                             */
+/*-----------------------------------------------------------------------------------------------*/
+static FalTraceRecord trace_buffer[FAL_TRACE_DEPTH];
+static uint32_t trace_head = 0;      // Next record to write, free running
+static uint32_t trace_tail = 0;      // Next record to read, free running
+static uint32_t trace_dropped = 0;
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Functions                                                                             */
+/*-----------------------------------------------------------------------------------------------*/
+static uint32_t trace_timestamp(void) {
+#if defined(ARDUINO)
+  return micros();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000000UL + ts.tv_nsec / 1000UL);
+#endif
+}
+
+static void log_write(const char *line) {
+#if defined(ARDUINO)
+  Serial.println(line);
+#else
+  puts(line);
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Public methods                                                                                */
+/*-----------------------------------------------------------------------------------------------*/
+/**************************************************************************************************
+ * @brief      Format and print one log line with its level prefix
+ * @param      level One of FAL_LOG_LEVEL_ERROR..FAL_LOG_LEVEL_DEBUG
+ * @param      fmt printf-style format string
+ * @return     Nothing
+ ********************************************************************************************** */
+void FalLog::print(int level, const char *fmt, ...) {
+  static const char prefix[] = { '?', 'E', 'W', 'I', 'D' };
+  char line[FAL_LOG_LINE_MAX];
+  va_list args;
+
+  int len = snprintf(line, sizeof(line), "[%c] ", prefix[(level >= 0 && level <= FAL_LOG_LEVEL_DEBUG) ? level : 0]);
+  va_start(args, fmt);
+  vsnprintf(line + len, sizeof(line) - len, fmt, args);
+  va_end(args);
+  log_write(line);
+}
+
+/**************************************************************************************************
+ * @brief      Append a record to the trace ring buffer
+ * @param      event FalTraceEvent identifier
+ * @param      arg0 First event argument
+ * @param      arg1 Second event argument
+ * @return     Nothing
+ ********************************************************************************************** */
+void FalTrace::record(uint16_t event, uint32_t arg0, uint32_t arg1) {
+  uint32_t timestamp = trace_timestamp();
+
+  FAL_TRACE_LOCK();
+  if ((trace_head - trace_tail) == FAL_TRACE_DEPTH) {
+    trace_tail++;
+    trace_dropped++;
+  }
+  FalTraceRecord *rec = &trace_buffer[trace_head & (FAL_TRACE_DEPTH - 1U)];
+  rec->timestamp = timestamp;
+  rec->event = event;
+  rec->sequence = (uint16_t)trace_head;
+  rec->arg0 = arg0;
+  rec->arg1 = arg1;
+  trace_head++;
+  FAL_TRACE_UNLOCK();
+}
+
+/**************************************************************************************************
+ * @brief      Pop records from the trace ring buffer
+ * @param      out Destination array
+ * @param      max Capacity of out in records
+ * @return     Number of records copied
+ ********************************************************************************************** */
+size_t FalTrace::read(FalTraceRecord *out, size_t max) {
+  size_t n = 0;
+
+  while (n < max) {
+    FAL_TRACE_LOCK();
+    bool empty = (trace_head == trace_tail);
+    if (!empty) {
+      out[n++] = trace_buffer[trace_tail & (FAL_TRACE_DEPTH - 1U)];
+      trace_tail++;
+    }
+    FAL_TRACE_UNLOCK();
+    if (empty) {
+      break;
+    }
+  }
+  return n;
+}
+
+/**************************************************************************************************
+ * @brief      Pop every pending record and print it, one line per record
+ * @return     Number of records printed
+ ********************************************************************************************** */
+size_t FalTrace::drain(void) {
+  static const char *const names[] = { "?", "erase", "write", "read", "sector", "error", "erased" };
+  FalTraceRecord rec;
+  char line[FAL_LOG_LINE_MAX];
+  size_t n = 0;
+
+  uint32_t lost = dropped();
+  if (lost != 0) {
+    snprintf(line, sizeof(line), "[T] %lu records dropped", (unsigned long)lost);
+    log_write(line);
+  }
+
+  while (read(&rec, 1) == 1) {
+    const char *name = (rec.event < sizeof(names) / sizeof(names[0])) ? names[rec.event] : names[0];
+    snprintf(line, sizeof(line), "[T] %10lu %5u %-6s 0x%08lX %lu",
+             (unsigned long)rec.timestamp, (unsigned)rec.sequence, name,
+             (unsigned long)rec.arg0, (unsigned long)rec.arg1);
+    log_write(line);
+    n++;
+  }
+  return n;
+}
+
+/**************************************************************************************************
+ * @brief      Number of records overwritten before being read
+ * @return     Dropped record count since the previous call
+ ********************************************************************************************** */
+uint32_t FalTrace::dropped(void) {
+  FAL_TRACE_LOCK();
+  uint32_t lost = trace_dropped;
+  trace_dropped = 0;
+  FAL_TRACE_UNLOCK();
+  return lost;
+}
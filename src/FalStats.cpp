@@ -0,0 +1,186 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : FalStats.cpp
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : I/O statistics of a Flash Abstraction Layer: bytes, operations, errors, latency
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : nucleo_f401re
+ * @compiler : gcc-arm-none-eabi
+ *
+ **************************************************************************************************
+ *
+ */
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Includes                                                                                      */
+/*-----------------------------------------------------------------------------------------------*/
+#include <string.h>
+#include "FalStats.h"
+#if defined(ARDUINO)
+  #include <Arduino.h>
+#else
+  #include <time.h>
+#endif
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Defines                                                                               */
+/*-----------------------------------------------------------------------------------------------*/
+#if defined(ARDUINO)
+  #define FAL_STATS_LOCK()   uint32_t primask = __get_PRIMASK(); __disable_irq()
+  #define FAL_STATS_UNLOCK() __set_PRIMASK(primask)
+#else
+  #define FAL_STATS_LOCK()   do {} while (0)
+  #define FAL_STATS_UNLOCK() do {} while (0)
+#endif
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Public methods                                                                                */
+/*-----------------------------------------------------------------------------------------------*/
+/**************************************************************************************************
+ * @brief      Read the cycle counter
+ * @return     DWT->CYCCNT on target, nanoseconds of the monotonic clock on the host
+ ********************************************************************************************** */
+uint32_t FalStatsRecorder::cycles(void) {
+#if defined(ARDUINO)
+  if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0U) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  }
+  return DWT->CYCCNT;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#endif
+}
+
+/**************************************************************************************************
+ * @brief      Rate of the cycle counter
+ * @return     Core clock in MHz on target, 1000 for the nanosecond clock on the host
+ ********************************************************************************************** */
+uint32_t FalStatsRecorder::cyclesPerMicrosecond(void) {
+#if defined(ARDUINO)
+  return SystemCoreClock / 1000000U;
+#else
+  return 1000U;
+#endif
+}
+
+#if FAL_STATS_ENABLED
+/**************************************************************************************************
+ * @brief      Constructor
+ * @param      sectorCount Number of sectors in the region, clamped to FAL_STATS_MAX_SECTORS
+ ********************************************************************************************** */
+FalStatsRecorder::FalStatsRecorder(uint32_t sectorCount) {
+  stats_.sectorCount = (sectorCount < FAL_STATS_MAX_SECTORS) ? sectorCount : FAL_STATS_MAX_SECTORS;
+  reset();
+}
+
+/**************************************************************************************************
+ * @brief      Count a successful operation and its latency
+ * @param      op Operation type
+ * @param      start cycles() when the operation started
+ * @return     Nothing
+ ********************************************************************************************** */
+void FalStatsRecorder::complete(FalStatsOp op, uint32_t start) {
+  sample(op, cycles() - start);
+}
+
+/**************************************************************************************************
+ * @brief      Count a successful operation with a known latency
+ * @param      op Operation type
+ * @param      elapsed Latency in cycles, e.g. simulated time
+ * @return     Nothing
+ ********************************************************************************************** */
+void FalStatsRecorder::sample(FalStatsOp op, uint32_t elapsed) {
+  FAL_STATS_LOCK();
+  FalLatency *lat = &stats_.latency[op];
+  lat->count++;
+  lat->total += elapsed;
+  lat->min = (elapsed < lat->min) ? elapsed : lat->min;
+  lat->max = (elapsed > lat->max) ? elapsed : lat->max;
+  FAL_STATS_UNLOCK();
+}
+
+/**************************************************************************************************
+ * @brief      Count bytes delivered by a read
+ * @param      bytes Number of bytes
+ * @return     Nothing
+ ********************************************************************************************** */
+void FalStatsRecorder::read(size_t bytes) {
+  FAL_STATS_LOCK();
+  stats_.bytesRead += bytes;
+  FAL_STATS_UNLOCK();
+}
+
+/**************************************************************************************************
+ * @brief      Count bytes programmed into flash
+ * @param      bytes Number of bytes
+ * @return     Nothing
+ ********************************************************************************************** */
+void FalStatsRecorder::programmed(size_t bytes) {
+  FAL_STATS_LOCK();
+  stats_.bytesProgrammed += bytes;
+  FAL_STATS_UNLOCK();
+}
+
+/**************************************************************************************************
+ * @brief      Count one erase cycle of a sector
+ * @param      sector Index of the sector from the start of the region
+ * @param      bytes Size of the sector
+ * @return     Nothing
+ ********************************************************************************************** */
+void FalStatsRecorder::erased(uint32_t sector, size_t bytes) {
+  FAL_STATS_LOCK();
+  stats_.bytesErased += bytes;
+  if (sector < stats_.sectorCount) {
+    stats_.sectorErases[sector]++;
+  }
+  FAL_STATS_UNLOCK();
+}
+
+/**************************************************************************************************
+ * @brief      Count a failure
+ * @param      cause What went wrong
+ * @return     Nothing
+ ********************************************************************************************** */
+void FalStatsRecorder::error(FalStatsError cause) {
+  FAL_STATS_LOCK();
+  stats_.errors[cause]++;
+  FAL_STATS_UNLOCK();
+}
+
+/**************************************************************************************************
+ * @brief      Copy a consistent view of the counters
+ * @param      out Destination
+ * @return     Nothing
+ ********************************************************************************************** */
+void FalStatsRecorder::snapshot(FalStats *out) const {
+  FAL_STATS_LOCK();
+  *out = stats_;
+  FAL_STATS_UNLOCK();
+  out->cyclesPerMicrosecond = cyclesPerMicrosecond();
+}
+
+/**************************************************************************************************
+ * @brief      Clear every counter
+ * @return     Nothing
+ ********************************************************************************************** */
+void FalStatsRecorder::reset(void) {
+  FAL_STATS_LOCK();
+  uint32_t sectorCount = stats_.sectorCount;
+  memset(&stats_, 0, sizeof(stats_));
+  for (size_t i = 0; i < FAL_STATS_OP_COUNT; i++) {
+    stats_.latency[i].min = UINT32_MAX;
+  }
+  stats_.sectorCount = sectorCount;
+  FAL_STATS_UNLOCK();
+}
+#endif // FAL_STATS_ENABLED
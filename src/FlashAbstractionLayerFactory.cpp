@@ -20,10 +20,81 @@
 /*-----------------------------------------------------------------------------------------------*/
 /* Includes                                                                                      */
 /*-----------------------------------------------------------------------------------------------*/
-#include <Arduino.h>
+#include <string.h>
 #include "FlashAbstractionLayerFactory.h"
-#if defined(STM32F4xx) 
-  #include "STM32F4FlashAbstractionLayer.h"
+#include "FlashTranslationLayer.h"
+#include "FalLog.h"
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Defines                                                                               */
+/*-----------------------------------------------------------------------------------------------*/
+#define TUNE_READ_SIZE          (16U)   // One ART prefetch line
+#define TUNE_PROG_SIZE          (1U)    // Any byte can be programmed
+#define TUNE_LOOKAHEAD_MIN      (8U)
+#define TUNE_LOOKAHEAD_MAX      (64U)   // Bytes of RAM spent on the allocator bitmap at most
+
+#if defined(STM32F4xx) || !defined(ARDUINO)
+  /* Table row for a part and the FAL type that drives it */
+  #define FAL_CANDIDATE(part, fal) \
+    { part::deviceId, part::flashSize, part::regionBase, part::regionSize, \
+      part::sectors[flashSectorIndex(part::sectors, part::sectorCount, part::regionBase)].size, &create_fal<fal> }
+#endif
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Types                                                                                 */
+/*-----------------------------------------------------------------------------------------------*/
+struct FalCandidate {
+  uint32_t deviceId;
+  uint32_t flashSize;
+  uint32_t regionBase;
+  uint32_t regionSize;
+  uint32_t sectorSize;
+  IFlashAbstractionLayer *(*create)(void);
+};
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Functions                                                                             */
+/*-----------------------------------------------------------------------------------------------*/
+#if defined(STM32F4xx) || !defined(ARDUINO)
+template <typename Fal>
+static IFlashAbstractionLayer *create_fal(void) {
+  return new Fal();
+}
+#endif
+
+#if defined(STM32F4xx)
+/* Linker script symbols, .data is the last section loaded into flash */
+extern "C" uint32_t _sidata;
+extern "C" uint32_t _sdata;
+extern "C" uint32_t _edata;
+
+/**
+ * @brief First flash address after the firmware image
+ */
+static uint32_t firmware_image_end(void) {
+  return (uint32_t)(uintptr_t)&_sidata + (uint32_t)((uintptr_t)&_edata - (uintptr_t)&_sdata);
+}
+
+/* Candidates in order of preference, the larger region of a part comes first */
+static const FalCandidate candidates[] = {
+#if FAL_FLASH_RUNTIME_DETECT
+  FAL_CANDIDATE(STM32F401xEFlashLarge, STM32F4FlashAbstractionLayer<STM32F401xEFlashLarge>),
+  FAL_CANDIDATE(STM32F401xEFlash, STM32F4FlashAbstractionLayer<STM32F401xEFlash>),
+  FAL_CANDIDATE(STM32F411xEFlashLarge, STM32F4FlashAbstractionLayer<STM32F411xEFlashLarge>),
+  FAL_CANDIDATE(STM32F411xEFlash, STM32F4FlashAbstractionLayer<STM32F411xEFlash>),
+  FAL_CANDIDATE(STM32F446xEFlashLarge, STM32F4FlashAbstractionLayer<STM32F446xEFlashLarge>),
+  FAL_CANDIDATE(STM32F446xEFlash, STM32F4FlashAbstractionLayer<STM32F446xEFlash>),
+  FAL_CANDIDATE(STM32F429xIFlashLarge, STM32F4DualBankFlashAbstractionLayer<STM32F429xIFlashLarge>),
+  FAL_CANDIDATE(STM32F429xIFlash, STM32F4DualBankFlashAbstractionLayer<STM32F429xIFlash>),
+#else
+  FAL_CANDIDATE(FAL_FLASH_PART, FAL_DEFAULT_TYPE),
+#endif
+};
+#elif !defined(ARDUINO)
+/* Host builds simulate the configured part */
+static const FalCandidate candidates[] = {
+  FAL_CANDIDATE(FAL_FLASH_PART, FAL_DEFAULT_TYPE),
+};
 #endif
 
 /*-----------------------------------------------------------------------------------------------*/
@@ -34,9 +105,78 @@
  * @return Pointer to Flash Abstraction Layer object
  */
 IFlashAbstractionLayer* FlashAbstractionLayerFactory::createFlashAbstractionLayer(void) {
+  FlashGeometry geometry;
+  return createFlashAbstractionLayer(&geometry);
+}
+
+/**
+ * @brief Detect the part and create the Flash Abstraction Layer with the largest safe region
+ * @param geometry Receives the detected part and the chosen region
+ * @return Pointer to Flash Abstraction Layer object, nullptr if no candidate matches
+ */
+IFlashAbstractionLayer* FlashAbstractionLayerFactory::createFlashAbstractionLayer(FlashGeometry *geometry) {
+  memset(geometry, 0, sizeof(*geometry));
+
 #if defined(STM32F4xx) 
-  return new STM32F4FlashAbstractionLayer();
+  geometry->deviceId = DBGMCU->IDCODE & DBGMCU_IDCODE_DEV_ID;
+  geometry->flashSize = (uint32_t)(*(const volatile uint16_t *)FLASHSIZE_BASE) * 1024U;
+  uint32_t imageEnd = firmware_image_end();
+
+  for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+    const FalCandidate *c = &candidates[i];
+    if (c->deviceId != geometry->deviceId || c->flashSize > geometry->flashSize || c->regionBase < imageEnd) {
+      continue;
+    }
+    geometry->regionBase = c->regionBase;
+    geometry->sectorSize = c->sectorSize;
+    geometry->sectorCount = c->regionSize / c->sectorSize;
+    geometry->blockSize = FlashTranslationLayer<>::minimumBlockSize(c->sectorSize);
+    FAL_LOG_INFO("Device 0x%03lX, %lu KB flash, region 0x%08lX+%lu KB", (unsigned long)geometry->deviceId,
+                 (unsigned long)(geometry->flashSize / 1024U), (unsigned long)c->regionBase,
+                 (unsigned long)(c->regionSize / 1024U));
+    return c->create();
+  }
+  FAL_LOG_ERROR("No flash region for device 0x%03lX with %lu KB and firmware ending at 0x%08lX",
+                (unsigned long)geometry->deviceId, (unsigned long)(geometry->flashSize / 1024U),
+                (unsigned long)imageEnd);
+  return nullptr;
+#elif !defined(ARDUINO)
+  const FalCandidate *c = &candidates[0];
+  geometry->deviceId = c->deviceId;
+  geometry->flashSize = c->flashSize;
+  geometry->regionBase = c->regionBase;
+  geometry->sectorSize = c->sectorSize;
+  geometry->sectorCount = c->regionSize / c->sectorSize;
+  geometry->blockSize = FlashTranslationLayer<>::minimumBlockSize(c->sectorSize);
+  FAL_LOG_INFO("Simulating device 0x%03lX, region 0x%08lX+%lu KB", (unsigned long)geometry->deviceId,
+               (unsigned long)c->regionBase, (unsigned long)(c->regionSize / 1024U));
+  return c->create();
 #else
   return nullptr;
 #endif
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Fill the geometry dependent lfs_config fields
+ * @param geometry Region chosen by createFlashAbstractionLayer()
+ * @param cfg Configuration to update
+ */
+void FlashAbstractionLayerFactory::tuneConfig(const FlashGeometry *geometry, struct lfs_config *cfg) {
+  uint32_t blockSize = (geometry->blockSize != 0U) ? geometry->blockSize : 1024U;
+
+  // A quarter block per cache keeps metadata commits in one buffer without pinning whole blocks
+  cfg->read_size = TUNE_READ_SIZE;
+  cfg->prog_size = TUNE_PROG_SIZE;
+  cfg->block_size = blockSize;
+  cfg->cache_size = blockSize / 4U;
+
+  // One bit per block, so a single scan of the allocator covers the whole region when it fits
+  uint32_t blocks = (geometry->sectorSize / blockSize) * geometry->sectorCount;
+  uint32_t lookahead = ((blocks + 63U) / 64U) * 8U;
+  if (lookahead < TUNE_LOOKAHEAD_MIN) {
+    lookahead = TUNE_LOOKAHEAD_MIN;
+  } else if (lookahead > TUNE_LOOKAHEAD_MAX) {
+    lookahead = TUNE_LOOKAHEAD_MAX;
+  }
+  cfg->lookahead_size = lookahead;
+}
@@ -0,0 +1,117 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : FlashBlankCheck.cpp
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : Word-wide blank check of memory-mapped flash
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : nucleo_f401re
+ * @compiler : gcc-arm-none-eabi
+ *
+ **************************************************************************************************
+ *
+ */
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Includes                                                                                      */
+/*-----------------------------------------------------------------------------------------------*/
+#include "FlashBlankCheck.h"
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Defines                                                                               */
+/*-----------------------------------------------------------------------------------------------*/
+#define BLANK_WORD (0xFFFFFFFFU)
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Public methods                                                                                */
+/*-----------------------------------------------------------------------------------------------*/
+/**************************************************************************************************
+ * @brief      Scan a flash range for programmed bytes
+ * @param      addr Start of the range, any alignment
+ * @param      size Number of bytes to scan
+ * @param      stopAtFirst Return at the first dirty word instead of counting all of them
+ * @param      result Receives the first dirty offset and dirty word count, may be nullptr
+ * @return     True if every byte is 0xFF, false otherwise
+ ********************************************************************************************** */
+bool FlashBlankCheck::scan(const void *addr, size_t size, bool stopAtFirst, FlashBlankCheckResult *result) {
+  const uint8_t *start = (const uint8_t *)addr;
+  const uint8_t *p = start;
+  const uint8_t *end = start + size;
+  size_t firstDirty = size;
+  uint32_t dirtyWords = 0;
+
+  // Unaligned head, counted as one partial word
+  bool headDirty = false;
+  while (p < end && ((uintptr_t)p & 3U) != 0U) {
+    if (*p != 0xFFU && !headDirty) {
+      headDirty = true;
+      firstDirty = (size_t)(p - start);
+    }
+    p++;
+  }
+  if (headDirty) {
+    dirtyWords++;
+    if (stopAtFirst) {
+      goto done;
+    }
+  }
+
+  {
+    const uint32_t *w = (const uint32_t *)p;
+    const uint32_t *wend = w + (size_t)(end - p) / 4U;
+
+    // Four words per compare, the exact word is only looked up when the block is dirty
+    while ((size_t)(wend - w) >= 4U) {
+      if ((w[0] & w[1] & w[2] & w[3]) != BLANK_WORD) {
+        for (int i = 0; i < 4; i++) {
+          if (w[i] != BLANK_WORD) {
+            if (dirtyWords == 0) {
+              firstDirty = (size_t)((const uint8_t *)&w[i] - start) + (size_t)(__builtin_ctz(~w[i]) / 8);
+            }
+            dirtyWords++;
+            if (stopAtFirst) {
+              goto done;
+            }
+          }
+        }
+      }
+      w += 4;
+    }
+    while (w < wend) {
+      if (*w != BLANK_WORD) {
+        if (dirtyWords == 0) {
+          firstDirty = (size_t)((const uint8_t *)w - start) + (size_t)(__builtin_ctz(~*w) / 8);
+        }
+        dirtyWords++;
+        if (stopAtFirst) {
+          goto done;
+        }
+      }
+      w++;
+    }
+    p = (const uint8_t *)w;
+  }
+
+  // Tail, counted as one partial word
+  for (const uint8_t *q = p; q < end; q++) {
+    if (*q != 0xFFU) {
+      if (dirtyWords == 0) {
+        firstDirty = (size_t)(q - start);
+      }
+      dirtyWords++;
+      break;
+    }
+  }
+
+done:
+  if (result != nullptr) {
+    result->firstDirty = firstDirty;
+    result->dirtyWords = dirtyWords;
+  }
+  return dirtyWords == 0;
+}
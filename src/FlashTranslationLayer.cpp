@@ -0,0 +1,781 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : FlashTranslationLayer.cpp
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : Logical-block translation layer mapping small LittleFS blocks onto large sectors
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : nucleo_f401re
+ * @compiler : gcc-arm-none-eabi
+ *
+ **************************************************************************************************
+ *
+ */
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Includes                                                                                      */
+/*-----------------------------------------------------------------------------------------------*/
+#include <stddef.h>
+#include <string.h>
+#include "FlashTranslationLayer.h"
+#include "FlashAbstractionLayerFactory.h"
+#include "FalLog.h"
+#include "FlashBlankCheck.h"
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Defines                                                                               */
+/*-----------------------------------------------------------------------------------------------*/
+#define FTL_MAGIC             (0x314C5446U)   // "FTL1"
+#define FTL_HEADER_SIZE       (16U)           // magic, sequence, block size, reserved
+#define FTL_TAG_SIZE          (4U)            // logical block (16 bits) + state (16 bits)
+#define FTL_TAG_VALID         (0x5AA5U)       // State half of a committed tag
+#define FTL_TAG_ERASED        (0xFFFFFFFFU)
+#define FTL_SLOT_FREE         (0xFFFFU)       // Unmapped logical block
+#define FTL_CHUNK_SIZE        (64U)           // Bytes moved per FAL call when scanning or copying
+#define FTL_IO_BATCH          (8U)            // Physical segments per FAL readv()/writev() call
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Types                                                                                 */
+/*-----------------------------------------------------------------------------------------------*/
+struct FtlSectorHeader {
+  uint32_t magic;
+  uint32_t sequence;
+  uint32_t blockSize;
+  uint32_t reserved;
+};
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Public methods                                                                                */
+/*-----------------------------------------------------------------------------------------------*/
+/**************************************************************************************************
+ * @brief      Constructor, does not touch flash until mount() or format()
+ * @param      fal Physical flash abstraction layer
+ * @param      sectorSize Physical erase unit in bytes
+ * @param      sectorCount Number of sectors in the FAL region, at least 2
+ * @param      blockSize Logical block size in bytes
+ * @return     Nothing
+ ********************************************************************************************** */
+template <typename Fal>
+FlashTranslationLayer<Fal>::FlashTranslationLayer(Fal *fal, uint32_t sectorSize,
+                                                  uint32_t sectorCount, uint32_t blockSize)
+  : fal_(fal), sectorSize_(sectorSize), sectorCount_(sectorCount), blockSize_(blockSize),
+    slotsPerSector_(0), logicalBlocks_(0), sequence_(0), activeSector_(-1), map_(nullptr) {
+  if (blockSize == 0 || (sectorSize % blockSize) != 0) {
+    return;
+  }
+  slotsPerSector_ = sectorSize / blockSize;
+
+  // Slot 0 must hold the header and every tag, and slot numbers must fit the 16-bit map
+  if (fal == nullptr || sectorCount < 2U || sectorCount > FTL_MAX_SECTORS ||
+      slotsPerSector_ <= FTL_RESERVED_SLOTS + 1U ||
+      FTL_HEADER_SIZE + FTL_TAG_SIZE * (slotsPerSector_ - 1U) > blockSize ||
+      sectorCount * slotsPerSector_ >= FTL_SLOT_FREE) {
+    return;
+  }
+
+  // One sector worth of slots is kept erased for garbage collection
+  logicalBlocks_ = (sectorCount - 1U) * (slotsPerSector_ - 1U - FTL_RESERVED_SLOTS);
+  map_ = new uint16_t[logicalBlocks_];
+  memset(map_, 0xFF, logicalBlocks_ * sizeof(map_[0]));
+  memset(sectors_, 0, sizeof(sectors_));
+}
+
+/**************************************************************************************************
+ * @brief      Destructor
+ * @return     Nothing
+ ********************************************************************************************** */
+template <typename Fal>
+FlashTranslationLayer<Fal>::~FlashTranslationLayer() {
+  delete[] map_;
+}
+
+/**************************************************************************************************
+ * @brief      Smallest logical block size the layer accepts for a sector size
+ * @param      sectorSize Physical erase unit in bytes
+ * @return     Block size in bytes, a power of two of at least 256
+ ********************************************************************************************** */
+template <typename Fal>
+uint32_t FlashTranslationLayer<Fal>::minimumBlockSize(uint32_t sectorSize) {
+  uint32_t blockSize = 256U;
+
+  while (blockSize < sectorSize && FTL_HEADER_SIZE + FTL_TAG_SIZE * (sectorSize / blockSize - 1U) > blockSize) {
+    blockSize <<= 1;
+  }
+  return blockSize;
+}
+
+/**************************************************************************************************
+ * @brief      Rebuild the logical to physical map from the sector tags
+ * @return     0 if successful, negative error code otherwise
+ ********************************************************************************************** */
+template <typename Fal>
+int FlashTranslationLayer<Fal>::mount(void) {
+  if (map_ == nullptr) {
+    FAL_LOG_ERROR("FTL: unsupported geometry");
+    return -1;
+  }
+
+  memset(map_, 0xFF, logicalBlocks_ * sizeof(map_[0]));
+  memset(sectors_, 0, sizeof(sectors_));
+  sequence_ = 0;
+  activeSector_ = -1;
+
+  // Classify sectors: formatted, erased, or left dirty by an interrupted erase or open
+  for (uint32_t s = 0; s < sectorCount_; s++) {
+    FtlSectorHeader hdr;
+    if (fal_->read((long)(s * sectorSize_), (uint8_t *)&hdr, sizeof(hdr)) < 0) {
+      return -1;
+    }
+    sectors_[s].nextSlot = 1;
+    if (hdr.magic == FTL_MAGIC && hdr.blockSize == blockSize_ && hdr.sequence != 0 && hdr.sequence != FTL_TAG_ERASED) {
+      sectors_[s].sequence = hdr.sequence;
+      if (hdr.sequence > sequence_) {
+        sequence_ = hdr.sequence;
+      }
+    } else {
+      bool blank;
+      if (isRangeErased((long)(s * sectorSize_), sectorSize_, &blank) != 0) {
+        return -1;
+      }
+      if (!blank) {
+        FAL_LOG_WARN("FTL: erasing unformatted sector %lu", (unsigned long)s);
+        if (eraseSector(s) != 0) {
+          return -1;
+        }
+      }
+    }
+  }
+
+  // Replay tags oldest sector first so the newest copy of each logical block wins
+  uint32_t last = 0;
+  for (;;) {
+    int32_t next = -1;
+    for (uint32_t s = 0; s < sectorCount_; s++) {
+      if (sectors_[s].sequence > last && (next < 0 || sectors_[s].sequence < sectors_[next].sequence)) {
+        next = (int32_t)s;
+      }
+    }
+    if (next < 0) {
+      break;
+    }
+    if (scanSector((uint32_t)next) != 0) {
+      return -1;
+    }
+    last = sectors_[next].sequence;
+    activeSector_ = next;
+  }
+
+  for (uint32_t lbn = 0; lbn < logicalBlocks_; lbn++) {
+    if (map_[lbn] != FTL_SLOT_FREE) {
+      sectors_[map_[lbn] / slotsPerSector_].liveSlots++;
+    }
+  }
+
+  // Power was lost while copying into the next free slot: retire it with a dead tag
+  if (activeSector_ >= 0 && sectors_[activeSector_].nextSlot < slotsPerSector_) {
+    uint16_t slot = (uint16_t)(activeSector_ * slotsPerSector_ + sectors_[activeSector_].nextSlot);
+    bool blank;
+    if (isRangeErased(slotOffset(slot), blockSize_, &blank) != 0) {
+      return -1;
+    }
+    if (!blank) {
+      uint32_t dead = 0;
+      if (fal_->write(tagOffset(slot), (const uint8_t *)&dead, sizeof(dead)) < 0) {
+        return -1;
+      }
+      sectors_[activeSector_].nextSlot++;
+    }
+  }
+
+  // Power was lost during garbage collection: finish moving the victim into the active sector
+  if (countErasedSectors() == 0) {
+    int32_t victim = -1;
+    for (uint32_t s = 0; s < sectorCount_; s++) {
+      if ((int32_t)s != activeSector_ && (victim < 0 || sectors_[s].liveSlots < sectors_[victim].liveSlots)) {
+        victim = (int32_t)s;
+      }
+    }
+    if (relocateSector((uint32_t)victim, (uint32_t)activeSector_) != 0) {
+      FAL_LOG_ERROR("FTL: no erased sector and no room to recover one");
+      return -1;
+    }
+  }
+
+  FAL_LOG_INFO("FTL: mounted %lu blocks, sequence %lu", (unsigned long)logicalBlocks_, (unsigned long)sequence_);
+  return 0;
+}
+
+/**************************************************************************************************
+ * @brief      Erase all sectors and forget every logical block
+ * @return     0 if successful, negative error code otherwise
+ ********************************************************************************************** */
+template <typename Fal>
+int FlashTranslationLayer<Fal>::format(void) {
+  if (map_ == nullptr) {
+    FAL_LOG_ERROR("FTL: unsupported geometry");
+    return -1;
+  }
+
+  for (uint32_t s = 0; s < sectorCount_; s++) {
+    if (eraseSector(s) != 0) {
+      return -1;
+    }
+  }
+  memset(map_, 0xFF, logicalBlocks_ * sizeof(map_[0]));
+  sequence_ = 0;
+  activeSector_ = -1;
+  return 0;
+}
+
+/**************************************************************************************************
+ * @brief      Erase logical blocks by remapping them to fresh slots
+ * @param      offset Logical offset, multiple of the block size
+ * @param      size Number of bytes to erase, multiple of the block size
+ * @return     Number of bytes erased if successful, negative error code otherwise
+ ********************************************************************************************** */
+template <typename Fal>
+int FlashTranslationLayer<Fal>::erase(long offset, size_t size) {
+  if (map_ == nullptr || offset < 0 || size == 0 || (offset % blockSize_) != 0 || (size % blockSize_) != 0 ||
+      (uint32_t)offset + size > logicalBlocks_ * blockSize_) {
+    FAL_LOG_ERROR("FTL: invalid erase offset 0x%lX or size %u", (unsigned long)offset, (unsigned)size);
+    return -1;
+  }
+
+  for (uint32_t lbn = (uint32_t)offset / blockSize_; lbn < ((uint32_t)offset + size) / blockSize_; lbn++) {
+    uint16_t slot;
+    if (allocateSlot((uint16_t)lbn, &slot) != 0) {
+      return -1;
+    }
+    if (map_[lbn] != FTL_SLOT_FREE) {
+      sectors_[map_[lbn] / slotsPerSector_].liveSlots--;
+    }
+    map_[lbn] = slot;
+    sectors_[slot / slotsPerSector_].liveSlots++;
+  }
+  return size;
+}
+
+/**************************************************************************************************
+ * @brief      Program logical blocks in place within their current slots
+ * @param      offset Logical offset to write to
+ * @param      buf Pointer to the data to write
+ * @param      size Number of bytes to write
+ * @return     Number of bytes written if successful, negative error code otherwise
+ ********************************************************************************************** */
+template <typename Fal>
+int FlashTranslationLayer<Fal>::write(long offset, const uint8_t *buf, size_t size) {
+  FlashIoSegment segment = { offset, (void *)buf, size };
+  return writev(&segment, 1);
+}
+
+/**************************************************************************************************
+ * @brief      Read logical blocks, unmapped blocks read as erased
+ * @param      offset Logical offset to read from
+ * @param      buf Pointer to buffer to store read data
+ * @param      size Number of bytes to read
+ * @return     Number of bytes read if successful, negative error code otherwise
+ ********************************************************************************************** */
+template <typename Fal>
+int FlashTranslationLayer<Fal>::read(long offset, uint8_t *buf, size_t size) {
+  FlashIoSegment segment = { offset, buf, size };
+  return readv(&segment, 1);
+}
+
+/**************************************************************************************************
+ * @brief      Program several logical ranges, forwarded to the FAL in batches
+ * @param      segs Segments with logical offsets, data is the source
+ * @param      count Number of segments
+ * @return     Total bytes written if successful, negative error code otherwise
+ ********************************************************************************************** */
+template <typename Fal>
+int FlashTranslationLayer<Fal>::writev(const FlashIoSegment *segs, size_t count) {
+  FlashIoSegment batch[FTL_IO_BATCH];
+  size_t queued = 0;
+  size_t total = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    long offset = segs[i].offset;
+    size_t size = segs[i].size;
+    if (!validRange(offset, size) || segs[i].data == nullptr) {
+      FAL_LOG_ERROR("FTL: invalid write offset 0x%lX or size %u", (unsigned long)offset, (unsigned)size);
+      return -1;
+    }
+
+    size_t done = 0;
+    while (done < size) {
+      uint32_t lbn = (uint32_t)(offset + done) / blockSize_;
+      uint32_t off = (uint32_t)(offset + done) % blockSize_;
+      size_t n = (size - done < blockSize_ - off) ? size - done : blockSize_ - off;
+
+      if (map_[lbn] == FTL_SLOT_FREE) {
+        FAL_LOG_ERROR("FTL: write to unerased block %lu", (unsigned long)lbn);
+        return -1;
+      }
+      if (queued == FTL_IO_BATCH) {
+        int err = fal_->writev(batch, queued);
+        if (err < 0) {
+          return err;
+        }
+        queued = 0;
+      }
+      batch[queued].offset = slotOffset(map_[lbn]) + off;
+      batch[queued].data = (uint8_t *)segs[i].data + done;
+      batch[queued].size = n;
+      queued++;
+      done += n;
+    }
+    total += size;
+  }
+
+  if (queued > 0) {
+    int err = fal_->writev(batch, queued);
+    if (err < 0) {
+      return err;
+    }
+  }
+  return (int)total;
+}
+
+/**************************************************************************************************
+ * @brief      Read several logical ranges, forwarded to the FAL in batches
+ * @param      segs Segments with logical offsets, data is the destination
+ * @param      count Number of segments
+ * @return     Total bytes read if successful, negative error code otherwise
+ ********************************************************************************************** */
+template <typename Fal>
+int FlashTranslationLayer<Fal>::readv(const FlashIoSegment *segs, size_t count) {
+  FlashIoSegment batch[FTL_IO_BATCH];
+  size_t queued = 0;
+  size_t total = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    long offset = segs[i].offset;
+    size_t size = segs[i].size;
+    if (!validRange(offset, size) || segs[i].data == nullptr) {
+      FAL_LOG_ERROR("FTL: invalid read offset 0x%lX or size %u", (unsigned long)offset, (unsigned)size);
+      return -1;
+    }
+
+    size_t done = 0;
+    while (done < size) {
+      uint32_t lbn = (uint32_t)(offset + done) / blockSize_;
+      uint32_t off = (uint32_t)(offset + done) % blockSize_;
+      size_t n = (size - done < blockSize_ - off) ? size - done : blockSize_ - off;
+      uint8_t *dst = (uint8_t *)segs[i].data + done;
+
+      if (map_[lbn] == FTL_SLOT_FREE) {
+        memset(dst, 0xFF, n);
+      } else {
+        if (queued == FTL_IO_BATCH) {
+          if (fal_->readv(batch, queued) < 0) {
+            return -1;
+          }
+          queued = 0;
+        }
+        batch[queued].offset = slotOffset(map_[lbn]) + off;
+        batch[queued].data = dst;
+        batch[queued].size = n;
+        queued++;
+      }
+      done += n;
+    }
+    total += size;
+  }
+
+  if (queued > 0 && fal_->readv(batch, queued) < 0) {
+    return -1;
+  }
+  return (int)total;
+}
+
+/**************************************************************************************************
+ * @brief      Commit all buffered write operations to flash memory
+ * @return     0 if successful, negative error code otherwise
+ ********************************************************************************************** */
+template <typename Fal>
+int FlashTranslationLayer<Fal>::sync() {
+  return fal_->sync();
+}
+
+/**************************************************************************************************
+ * @brief      Verify a logical range reads as erased
+ * @param      addr Logical offset, not an absolute flash address
+ * @param      size Size to check
+ * @return     True if erased (all 0xFF), false otherwise
+ ********************************************************************************************** */
+template <typename Fal>
+bool FlashTranslationLayer<Fal>::verify_flash_erased(uint32_t addr, size_t size) {
+  uint8_t chunk[FTL_CHUNK_SIZE];
+
+  for (size_t done = 0; done < size; done += sizeof(chunk)) {
+    size_t n = (size - done < sizeof(chunk)) ? size - done : sizeof(chunk);
+    if (read((long)(addr + done), chunk, n) < 0) {
+      return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+      if (chunk[i] != 0xFF) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/**************************************************************************************************
+ * @brief      Get a direct pointer to a range inside one logical block
+ * @param      offset Logical offset of the range
+ * @param      size Size of the range, must not cross a block boundary
+ * @return     Pointer into the mapped slot, nullptr if unmapped or not memory-mapped
+ * @note       Valid only until the next write or erase, either may garbage collect the sector
+ ********************************************************************************************** */
+template <typename Fal>
+const uint8_t *FlashTranslationLayer<Fal>::map(long offset, size_t size) {
+  if (map_ == nullptr || offset < 0 || (uint32_t)offset + size > logicalBlocks_ * blockSize_) {
+    return nullptr;
+  }
+
+  uint32_t lbn = (uint32_t)offset / blockSize_;
+  uint32_t off = (uint32_t)offset % blockSize_;
+  if (off + size > blockSize_ || map_[lbn] == FTL_SLOT_FREE) {
+    return nullptr;
+  }
+  return fal_->map(slotOffset(map_[lbn]) + off, size);
+}
+
+/**************************************************************************************************
+ * @brief      Copy the statistics of the underlying layer
+ * @param      out Destination
+ * @return     True if the underlying layer keeps statistics
+ * @note       The counters are physical: garbage collection copies and tag writes are included
+ ********************************************************************************************** */
+template <typename Fal>
+bool FlashTranslationLayer<Fal>::getStats(FalStats *out) const {
+  return fal_->getStats(out);
+}
+
+/**************************************************************************************************
+ * @brief      Clear the statistics of the underlying layer
+ * @return     Nothing
+ ********************************************************************************************** */
+template <typename Fal>
+void FlashTranslationLayer<Fal>::resetStats() {
+  fal_->resetStats();
+}
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private methods                                                                               */
+/*-----------------------------------------------------------------------------------------------*/
+/**
+ * @brief Replay the tags of a formatted sector into the map
+ * @param sector Physical sector index
+ * @return 0 if successful, negative error code otherwise
+ */
+template <typename Fal>
+int FlashTranslationLayer<Fal>::scanSector(uint32_t sector) {
+  uint32_t tags[FTL_CHUNK_SIZE / FTL_TAG_SIZE];
+  uint32_t slot = 1;
+
+  while (slot < slotsPerSector_) {
+    uint32_t count = slotsPerSector_ - slot;
+    if (count > FTL_CHUNK_SIZE / FTL_TAG_SIZE) {
+      count = FTL_CHUNK_SIZE / FTL_TAG_SIZE;
+    }
+    if (fal_->read(tagOffset((uint16_t)(sector * slotsPerSector_ + slot)), (uint8_t *)tags, count * FTL_TAG_SIZE) < 0) {
+      return -1;
+    }
+    for (uint32_t i = 0; i < count; i++, slot++) {
+      if (tags[i] == FTL_TAG_ERASED) {
+        // Slots are allocated in order, the first free tag ends the log
+        sectors_[sector].nextSlot = (uint16_t)slot;
+        return 0;
+      }
+      uint16_t lbn = (uint16_t)(tags[i] & 0xFFFFU);
+      if ((tags[i] >> 16) == FTL_TAG_VALID && lbn < logicalBlocks_) {
+        map_[lbn] = (uint16_t)(sector * slotsPerSector_ + slot);
+      }
+    }
+  }
+  sectors_[sector].nextSlot = (uint16_t)slotsPerSector_;
+  return 0;
+}
+
+/**
+ * @brief Erase a physical sector and mark it as available
+ * @param sector Physical sector index
+ * @return 0 if successful, negative error code otherwise
+ */
+template <typename Fal>
+int FlashTranslationLayer<Fal>::eraseSector(uint32_t sector) {
+  if (fal_->erase((long)(sector * sectorSize_), sectorSize_) < 0) {
+    FAL_LOG_ERROR("FTL: failed to erase sector %lu", (unsigned long)sector);
+    return -1;
+  }
+  sectors_[sector].sequence = 0;
+  sectors_[sector].nextSlot = 1;
+  sectors_[sector].liveSlots = 0;
+  return 0;
+}
+
+/**
+ * @brief Stamp an erased sector with the next sequence number and make it the active one
+ * @param sector Physical sector index
+ * @return 0 if successful, negative error code otherwise
+ */
+template <typename Fal>
+int FlashTranslationLayer<Fal>::openSector(uint32_t sector) {
+  FtlSectorHeader hdr = { FTL_MAGIC, sequence_ + 1U, blockSize_, FTL_TAG_ERASED };
+
+  // The reserved word is left erased
+  if (fal_->write((long)(sector * sectorSize_), (const uint8_t *)&hdr, offsetof(FtlSectorHeader, reserved)) < 0) {
+    return -1;
+  }
+  sequence_++;
+  sectors_[sector].sequence = sequence_;
+  sectors_[sector].nextSlot = 1;
+  sectors_[sector].liveSlots = 0;
+  activeSector_ = (int32_t)sector;
+  return 0;
+}
+
+/**
+ * @brief Take the next free slot of the active sector and tag it with a logical block
+ * @param lbn Logical block number
+ * @param slot Receives the global slot number
+ * @return 0 if successful, negative error code otherwise
+ */
+template <typename Fal>
+int FlashTranslationLayer<Fal>::allocateSlot(uint16_t lbn, uint16_t *slot) {
+  if (activeSector_ < 0 || sectors_[activeSector_].nextSlot >= slotsPerSector_) {
+    if (collectGarbage() != 0) {
+      return -1;
+    }
+  }
+
+  *slot = (uint16_t)(activeSector_ * slotsPerSector_ + sectors_[activeSector_].nextSlot);
+  if (writeTag(*slot, lbn) != 0) {
+    return -1;
+  }
+  sectors_[activeSector_].nextSlot++;
+  return 0;
+}
+
+/**
+ * @brief Provide an active sector with free slots while keeping one sector erased
+ * @return 0 if successful, negative error code otherwise
+ */
+template <typename Fal>
+int FlashTranslationLayer<Fal>::collectGarbage(void) {
+  int erased = countErasedSectors();
+  int spare = findErasedSector();
+
+  if (spare < 0) {
+    FAL_LOG_ERROR("FTL: no erased sector left");
+    return -1;
+  }
+  if (erased >= 2) {
+    return openSector((uint32_t)spare);
+  }
+
+  // Only the reserved sector is erased: move the emptiest sector into it, then erase that one
+  int32_t victim = -1;
+  for (uint32_t s = 0; s < sectorCount_; s++) {
+    if (sectors_[s].sequence != 0 && (victim < 0 || sectors_[s].liveSlots < sectors_[victim].liveSlots)) {
+      victim = (int32_t)s;
+    }
+  }
+  FAL_LOG_DEBUG("FTL: collecting sector %ld (%u live) into %d", (long)victim,
+                (unsigned)sectors_[victim].liveSlots, spare);
+
+  if (openSector((uint32_t)spare) != 0 || relocateSector((uint32_t)victim, (uint32_t)spare) != 0) {
+    return -1;
+  }
+  if (sectors_[spare].nextSlot >= slotsPerSector_) {
+    FAL_LOG_ERROR("FTL: out of space");
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Copy the live slots of a sector to the end of another one and erase it
+ * @param victim Sector to reclaim
+ * @param target Active sector receiving the live slots
+ * @return 0 if successful, negative error code otherwise
+ */
+template <typename Fal>
+int FlashTranslationLayer<Fal>::relocateSector(uint32_t victim, uint32_t target) {
+  for (uint32_t slot = 1; slot < sectors_[victim].nextSlot; slot++) {
+    uint16_t from = (uint16_t)(victim * slotsPerSector_ + slot);
+    uint32_t tag;
+
+    if (fal_->read(tagOffset(from), (uint8_t *)&tag, sizeof(tag)) < 0) {
+      return -1;
+    }
+    uint16_t lbn = (uint16_t)(tag & 0xFFFFU);
+    if (lbn >= logicalBlocks_ || map_[lbn] != from) {
+      continue;
+    }
+    if (sectors_[target].nextSlot >= slotsPerSector_) {
+      return -1;
+    }
+
+    uint16_t to = (uint16_t)(target * slotsPerSector_ + sectors_[target].nextSlot);
+    if (copySlot(from, to) != 0 || writeTag(to, lbn) != 0) {
+      return -1;
+    }
+    sectors_[target].nextSlot++;
+    sectors_[target].liveSlots++;
+    sectors_[victim].liveSlots--;
+    map_[lbn] = to;
+  }
+  return eraseSector(victim);
+}
+
+/**
+ * @brief Copy the data of one slot to another, the tag is written separately afterwards
+ * @param from Source global slot number
+ * @param to Destination global slot number, erased
+ * @return 0 if successful, negative error code otherwise
+ */
+template <typename Fal>
+int FlashTranslationLayer<Fal>::copySlot(uint16_t from, uint16_t to) {
+  uint8_t chunk[FTL_CHUNK_SIZE];
+
+  for (uint32_t off = 0; off < blockSize_; off += sizeof(chunk)) {
+    uint32_t n = (blockSize_ - off < sizeof(chunk)) ? blockSize_ - off : sizeof(chunk);
+    if (fal_->read(slotOffset(from) + off, chunk, n) < 0) {
+      return -1;
+    }
+    // Erased bytes need no programming
+    uint32_t first = 0, last = n;
+    while (first < n && chunk[first] == 0xFF) {
+      first++;
+    }
+    while (last > first && chunk[last - 1U] == 0xFF) {
+      last--;
+    }
+    if (last > first && fal_->write(slotOffset(to) + off + first, chunk + first, last - first) < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Commit the mapping of a slot to a logical block
+ * @param slot Global slot number
+ * @param lbn Logical block number
+ * @return 0 if successful, negative error code otherwise
+ */
+template <typename Fal>
+int FlashTranslationLayer<Fal>::writeTag(uint16_t slot, uint16_t lbn) {
+  uint32_t tag = ((uint32_t)FTL_TAG_VALID << 16) | lbn;
+
+  return (fal_->write(tagOffset(slot), (const uint8_t *)&tag, sizeof(tag)) < 0) ? -1 : 0;
+}
+
+/**
+ * @brief Check that a physical range reads as erased
+ * @param offset Offset relative to the FAL region
+ * @param size Number of bytes to check
+ * @param blank Receives true if every byte is 0xFF
+ * @return 0 if successful, negative error code otherwise
+ */
+template <typename Fal>
+int FlashTranslationLayer<Fal>::isRangeErased(long offset, uint32_t size, bool *blank) {
+  uint8_t chunk[FTL_CHUNK_SIZE];
+
+  const uint8_t *mapped = fal_->map(offset, size);
+  if (mapped != nullptr) {
+    *blank = FlashBlankCheck::isBlank(mapped, size);
+    return 0;
+  }
+
+  *blank = true;
+  for (uint32_t done = 0; done < size; done += sizeof(chunk)) {
+    uint32_t n = (size - done < sizeof(chunk)) ? size - done : sizeof(chunk);
+    if (fal_->read(offset + done, chunk, n) < 0) {
+      return -1;
+    }
+    if (!FlashBlankCheck::isBlank(chunk, n)) {
+      *blank = false;
+      return 0;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Check that a non-empty logical range lies inside the logical capacity
+ * @param offset Logical offset
+ * @param size Number of bytes
+ * @return True if the range is valid and the layer is usable
+ */
+template <typename Fal>
+bool FlashTranslationLayer<Fal>::validRange(long offset, size_t size) const {
+  uint32_t capacity = logicalBlocks_ * blockSize_;
+  return map_ != nullptr && offset >= 0 && size != 0 && (uint32_t)offset < capacity &&
+         size <= capacity - (uint32_t)offset;
+}
+
+/**
+ * @brief Find an erased sector
+ * @return Sector index, or -1 if none is erased
+ */
+template <typename Fal>
+int FlashTranslationLayer<Fal>::findErasedSector(void) const {
+  for (uint32_t s = 0; s < sectorCount_; s++) {
+    if (sectors_[s].sequence == 0) {
+      return (int)s;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief Count erased sectors
+ * @return Number of sectors without a header
+ */
+template <typename Fal>
+int FlashTranslationLayer<Fal>::countErasedSectors(void) const {
+  int count = 0;
+  for (uint32_t s = 0; s < sectorCount_; s++) {
+    if (sectors_[s].sequence == 0) {
+      count++;
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief Locate the tag of a slot
+ * @param slot Global slot number
+ * @return Offset of the tag relative to the FAL region
+ */
+template <typename Fal>
+long FlashTranslationLayer<Fal>::tagOffset(uint16_t slot) const {
+  return (long)((slot / slotsPerSector_) * sectorSize_ + FTL_HEADER_SIZE + ((slot % slotsPerSector_) - 1U) * FTL_TAG_SIZE);
+}
+
+/**
+ * @brief Convert a global slot number to a FAL offset
+ * @param slot Global slot number
+ * @return Offset of the slot data relative to the FAL region
+ */
+template <typename Fal>
+long FlashTranslationLayer<Fal>::slotOffset(uint16_t slot) const {
+  return (long)((slot / slotsPerSector_) * sectorSize_ + (slot % slotsPerSector_) * blockSize_);
+}
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Instantiations                                                                                */
+/*-----------------------------------------------------------------------------------------------*/
+template class FlashTranslationLayer<IFlashAbstractionLayer>;
+#if defined(FAL_DEFAULT_TYPE)
+template class FlashTranslationLayer<FAL_DEFAULT_TYPE>;
+#endif
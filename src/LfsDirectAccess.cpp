@@ -0,0 +1,75 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : LfsDirectAccess.cpp
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : Zero-copy access to LittleFS file contents in memory-mapped flash
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : nucleo_f401re
+ * @compiler : gcc-arm-none-eabi
+ *
+ **************************************************************************************************
+ *
+ */
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Includes                                                                                      */
+/*-----------------------------------------------------------------------------------------------*/
+#include "LfsDirectAccess.h"
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Types                                                                                 */
+/*-----------------------------------------------------------------------------------------------*/
+struct SpanWalk {
+  IFlashAbstractionLayer *fal;
+  lfs_size_t blockSize;
+  LfsDirectAccess::SpanCallback cb;
+  void *ctx;
+};
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Functions                                                                             */
+/*-----------------------------------------------------------------------------------------------*/
+/**
+ * @brief Translate one block range reported by lfs_file_spans into a flash pointer
+ * @return Value of the user callback, or LFS_ERR_INVAL if the block is not memory-mapped
+ */
+static int span_walk_block(void *data, lfs_off_t pos, lfs_block_t block, lfs_off_t off, lfs_size_t size) {
+  SpanWalk *walk = (SpanWalk *)data;
+  FlashSpan span;
+
+  span.pos = pos;
+  span.size = size;
+  span.data = walk->fal->map((long)block * walk->blockSize + off, size);
+  if (span.data == nullptr) {
+    return LFS_ERR_INVAL;
+  }
+  return walk->cb(walk->ctx, span);
+}
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Public methods                                                                                */
+/*-----------------------------------------------------------------------------------------------*/
+/**************************************************************************************************
+ * @brief      Call cb with a direct flash pointer for every data block of a file
+ * @param      lfs Mounted filesystem
+ * @param      file Open file
+ * @param      fal Layer the filesystem's block device callbacks forward to
+ * @param      cb Called once per block, last block first
+ * @param      ctx Passed through to cb
+ * @return     0 if successful, the first non-zero cb result, or a negative error code
+ ********************************************************************************************** */
+int LfsDirectAccess::forEachSpan(lfs_t *lfs, lfs_file_t *file, IFlashAbstractionLayer *fal,
+                                 SpanCallback cb, void *ctx) {
+  if (fal == nullptr || cb == nullptr) {
+    return LFS_ERR_INVAL;
+  }
+
+  SpanWalk walk = { fal, lfs->cfg->block_size, cb, ctx };
+  return lfs_file_spans(lfs, file, span_walk_block, &walk);
+}
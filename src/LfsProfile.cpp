@@ -0,0 +1,194 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : LfsProfile.cpp
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : Cycle counter and CSV/binary dump of the LittleFS latency profile
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : nucleo_f401re
+ * @compiler : gcc-arm-none-eabi
+ *
+ **************************************************************************************************
+ *
+ */
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Includes                                                                                      */
+/*-----------------------------------------------------------------------------------------------*/
+#include <stdarg.h>
+#include <stdio.h>
+#include "LfsProfile.h"
+#include "FalStats.h"
+#if defined(ARDUINO)
+  #include <Arduino.h>
+#endif
+
+#ifdef LFS_PROFILE
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Defines                                                                               */
+/*-----------------------------------------------------------------------------------------------*/
+#define LFS_PROFILE_LINE_MAX (96U)   // Longest CSV fragment formatted at once
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Functions                                                                             */
+/*-----------------------------------------------------------------------------------------------*/
+/** @brief Default sink, the serial console */
+static void console_write(void *ctx, const uint8_t *data, size_t size) {
+  (void)ctx;
+#if defined(ARDUINO)
+  Serial.write(data, size);
+#else
+  fwrite(data, 1, size, stdout);
+#endif
+}
+
+/** @brief Format into a line buffer and pass it to the sink */
+static void emit(LfsProfileWriter write, void *ctx, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+static void emit(LfsProfileWriter write, void *ctx, const char *fmt, ...) {
+  char line[LFS_PROFILE_LINE_MAX];
+  va_list args;
+
+  va_start(args, fmt);
+  int len = vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  if (len > 0) {
+    write(ctx, (const uint8_t *)line, ((size_t)len < sizeof(line)) ? (size_t)len : sizeof(line) - 1U);
+  }
+}
+
+/** @brief Append a little-endian integer of size bytes to buf */
+static size_t put_le(uint8_t *buf, uint64_t value, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    buf[i] = (uint8_t)(value >> (8U * i));
+  }
+  return size;
+}
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Port Functions                                                                                */
+/*-----------------------------------------------------------------------------------------------*/
+/**
+ * @brief Cycle counter used by lfs.c, the same DWT counter as the FAL statistics
+ */
+extern "C" uint32_t lfs_profile_cycles(void) {
+  return FalStatsRecorder::cycles();
+}
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Public methods                                                                                */
+/*-----------------------------------------------------------------------------------------------*/
+/**************************************************************************************************
+ * @brief      Write one CSV row per call that ran since the last reset
+ * @param      write Sink for the text, nullptr for the serial console
+ * @param      ctx Passed through to write
+ * @return     Number of rows written, without the header
+ ********************************************************************************************** */
+size_t LfsProfile::dumpCsv(LfsProfileWriter write, void *ctx) {
+  size_t rows = 0;
+
+  if (write == nullptr) {
+    write = console_write;
+  }
+
+  emit(write, ctx, "call,count,total,max");
+  for (int p = 0; p < LFS_PROFILE_PHASE_COUNT; p++) {
+    const char *name = lfs_profile_phase_name((enum lfs_profile_phase)p);
+    emit(write, ctx, ",%s_n,%s", name, name);
+  }
+  for (int b = 0; b < LFS_PROFILE_BUCKETS; b++) {
+    emit(write, ctx, ",h%d", b);
+  }
+  emit(write, ctx, "\r\n");
+
+  for (int c = 0; c < LFS_PROFILE_CALL_COUNT; c++) {
+    const struct lfs_profile_call_stats *stats = lfs_profile_get((enum lfs_profile_call)c);
+    if (stats->count == 0) {
+      continue;
+    }
+    emit(write, ctx, "%s,%lu,%llu,%lu", lfs_profile_call_name((enum lfs_profile_call)c),
+         (unsigned long)stats->count, (unsigned long long)stats->total, (unsigned long)stats->max);
+    for (int p = 0; p < LFS_PROFILE_PHASE_COUNT; p++) {
+      emit(write, ctx, ",%lu,%llu", (unsigned long)stats->phase_count[p], (unsigned long long)stats->phase_total[p]);
+    }
+    for (int b = 0; b < LFS_PROFILE_BUCKETS; b++) {
+      emit(write, ctx, ",%lu", (unsigned long)stats->hist[b]);
+    }
+    emit(write, ctx, "\r\n");
+    rows++;
+  }
+  return rows;
+}
+
+/**************************************************************************************************
+ * @brief      Write the profile in the compact binary format
+ * @param      write Sink for the bytes, nullptr for the serial console
+ * @param      ctx Passed through to write
+ * @return     Number of bytes written
+ * @note       Only the non-empty range of each histogram is sent
+ ********************************************************************************************** */
+size_t LfsProfile::dumpBinary(LfsProfileWriter write, void *ctx) {
+  uint8_t buf[32 + 12 * LFS_PROFILE_PHASE_COUNT + 4 * LFS_PROFILE_BUCKETS];
+  size_t bytes = 0;
+  uint8_t records = 0;
+
+  if (write == nullptr) {
+    write = console_write;
+  }
+  for (int c = 0; c < LFS_PROFILE_CALL_COUNT; c++) {
+    records += (lfs_profile_get((enum lfs_profile_call)c)->count != 0) ? 1U : 0U;
+  }
+
+  size_t n = 0;
+  buf[n++] = 'L';
+  buf[n++] = 'F';
+  buf[n++] = 'S';
+  buf[n++] = 'P';
+  buf[n++] = LFS_PROFILE_DUMP_VERSION;
+  buf[n++] = LFS_PROFILE_BUCKETS;
+  buf[n++] = LFS_PROFILE_PHASE_COUNT;
+  buf[n++] = records;
+  n += put_le(&buf[n], FalStatsRecorder::cyclesPerMicrosecond(), 4);
+  write(ctx, buf, n);
+  bytes += n;
+
+  for (int c = 0; c < LFS_PROFILE_CALL_COUNT; c++) {
+    const struct lfs_profile_call_stats *stats = lfs_profile_get((enum lfs_profile_call)c);
+    if (stats->count == 0) {
+      continue;
+    }
+    n = 0;
+    buf[n++] = (uint8_t)c;
+    n += put_le(&buf[n], stats->count, 4);
+    n += put_le(&buf[n], stats->total, 8);
+    n += put_le(&buf[n], stats->max, 4);
+    for (int p = 0; p < LFS_PROFILE_PHASE_COUNT; p++) {
+      n += put_le(&buf[n], stats->phase_count[p], 4);
+      n += put_le(&buf[n], stats->phase_total[p], 8);
+    }
+
+    int first = 0;
+    int last = LFS_PROFILE_BUCKETS - 1;
+    while (first < last && stats->hist[first] == 0) {
+      first++;
+    }
+    while (last > first && stats->hist[last] == 0) {
+      last--;
+    }
+    buf[n++] = (uint8_t)first;
+    buf[n++] = (uint8_t)(last - first + 1);
+    for (int b = first; b <= last; b++) {
+      n += put_le(&buf[n], stats->hist[b], 4);
+    }
+    write(ctx, buf, n);
+    bytes += n;
+  }
+  return bytes;
+}
+
+#endif // LFS_PROFILE
@@ -0,0 +1,183 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : LfsRtos.cpp
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : FreeRTOS locking hooks and flash service task for sharing LittleFS between tasks
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : nucleo_f401re
+ * @compiler : gcc-arm-none-eabi
+ *
+ **************************************************************************************************
+ *
+ */
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Includes                                                                                      */
+/*-----------------------------------------------------------------------------------------------*/
+#include "LfsRtos.h"
+
+#if FAL_RTOS_ENABLED
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Variables                                                                             */
+/*-----------------------------------------------------------------------------------------------*/
+static SemaphoreHandle_t flash_mutex = nullptr;
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Functions                                                                             */
+/*-----------------------------------------------------------------------------------------------*/
+/** @brief True once vTaskStartScheduler() has run, before that there is nothing to block on */
+static bool scheduler_running(void) {
+  return xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED;
+}
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Public methods                                                                                */
+/*-----------------------------------------------------------------------------------------------*/
+/**************************************************************************************************
+ * @brief      Create the mutex shared by every filesystem on the internal flash
+ * @return     0 on success, LFS_ERR_NOMEM if the mutex cannot be allocated
+ ********************************************************************************************** */
+int LfsRtos::begin(void) {
+  if (flash_mutex == nullptr) {
+    // A mutex, not a binary semaphore, so the holder inherits the priority of waiters
+    flash_mutex = xSemaphoreCreateMutex();
+  }
+  return (flash_mutex != nullptr) ? 0 : LFS_ERR_NOMEM;
+}
+
+#if defined(LFS_THREADSAFE)
+/**************************************************************************************************
+ * @brief      Install the lock/unlock hooks in an lfs_config
+ * @param      cfg Configuration to update
+ * @return     Nothing
+ ********************************************************************************************** */
+void LfsRtos::bind(struct lfs_config *cfg) {
+  cfg->lock = lock;
+  cfg->unlock = unlock;
+}
+#endif
+
+/**************************************************************************************************
+ * @brief      Take the flash mutex, waiting as long as needed
+ * @param      cfg Unused, the mutex is shared by all filesystems
+ * @return     0 on success, LFS_ERR_IO if begin() was not called
+ ********************************************************************************************** */
+int LfsRtos::lock(const struct lfs_config *cfg) {
+  (void)cfg;
+  if (flash_mutex == nullptr) {
+    return LFS_ERR_IO;
+  }
+  if (!scheduler_running()) {
+    return 0;
+  }
+  return (xSemaphoreTake(flash_mutex, portMAX_DELAY) == pdTRUE) ? 0 : LFS_ERR_IO;
+}
+
+/**************************************************************************************************
+ * @brief      Give the flash mutex back
+ * @param      cfg Unused, the mutex is shared by all filesystems
+ * @return     0 on success, LFS_ERR_IO if the caller does not hold the mutex
+ ********************************************************************************************** */
+int LfsRtos::unlock(const struct lfs_config *cfg) {
+  (void)cfg;
+  if (flash_mutex == nullptr) {
+    return LFS_ERR_IO;
+  }
+  if (!scheduler_running()) {
+    return 0;
+  }
+  return (xSemaphoreGive(flash_mutex) == pdTRUE) ? 0 : LFS_ERR_IO;
+}
+
+/**************************************************************************************************
+ * @brief      Let other tasks run while the FAL waits for the flash controller
+ * @return     Nothing
+ ********************************************************************************************** */
+void LfsRtos::idleHook(void) {
+  if (scheduler_running()) {
+    vTaskDelay(1);
+  }
+}
+
+/**************************************************************************************************
+ * @brief      Constructor
+ * @param      lfs Filesystem owned by the service task
+ ********************************************************************************************** */
+LfsService::LfsService(lfs_t *lfs)
+  : lfs_(lfs),
+    queue_(nullptr),
+    task_(nullptr) {
+}
+
+/**************************************************************************************************
+ * @brief      Create the request queue and the service task
+ * @param      priority FreeRTOS priority of the task
+ * @param      stackWords Stack depth of the task in words
+ * @return     0 on success, LFS_ERR_NOMEM if the queue or task cannot be allocated
+ ********************************************************************************************** */
+int LfsService::start(UBaseType_t priority, uint32_t stackWords) {
+  if (task_ != nullptr) {
+    return 0;
+  }
+  if (queue_ == nullptr) {
+    queue_ = xQueueCreate(LFS_SERVICE_QUEUE_DEPTH, sizeof(Request));
+    if (queue_ == nullptr) {
+      return LFS_ERR_NOMEM;
+    }
+  }
+  if (xTaskCreate(run, "lfs", (configSTACK_DEPTH_TYPE)stackWords, this, priority, &task_) != pdPASS) {
+    task_ = nullptr;
+    return LFS_ERR_NOMEM;
+  }
+  return 0;
+}
+
+/**************************************************************************************************
+ * @brief      Execute a request in the service task and wait for it to finish
+ * @param      fn Work to run with the service's lfs_t
+ * @param      arg Argument passed to fn, must stay valid until call() returns
+ * @return     Result of fn, or LFS_ERR_IO if the service is not running
+ ********************************************************************************************** */
+int LfsService::call(LfsServiceFn fn, void *arg) {
+  if (!scheduler_running() || xTaskGetCurrentTaskHandle() == task_) {
+    return fn(lfs_, arg);
+  }
+  if (task_ == nullptr) {
+    return LFS_ERR_IO;
+  }
+
+  int result = LFS_ERR_IO;
+  Request req = { fn, arg, xTaskGetCurrentTaskHandle(), &result };
+  if (xQueueSend(queue_, &req, portMAX_DELAY) != pdTRUE) {
+    return LFS_ERR_IO;
+  }
+  // The service writes result before notifying, so the wait never returns early
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  return result;
+}
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private methods                                                                               */
+/*-----------------------------------------------------------------------------------------------*/
+/** @brief Service task body, executes queued requests in arrival order */
+void LfsService::run(void *param) {
+  LfsService *self = static_cast<LfsService *>(param);
+  Request req;
+
+  for (;;) {
+    if (xQueueReceive(self->queue_, &req, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    *req.result = req.fn(self->lfs_, req.arg);
+    xTaskNotifyGive(req.caller);
+  }
+}
+
+#endif // FAL_RTOS_ENABLED
@@ -0,0 +1,100 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : STM32F4DualBankFlashAbstractionLayer.cpp
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : Read-while-write Flash Abstraction Layer for dual-bank STM32F42x/43x parts
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : nucleo_f429zi
+ * @compiler : gcc-arm-none-eabi
+ *
+ **************************************************************************************************
+ *
+ */
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Includes                                                                                      */
+/*-----------------------------------------------------------------------------------------------*/
+#include <Arduino.h>
+#include "STM32F4DualBankFlashAbstractionLayer.h"
+#include "FalLog.h"
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Public methods                                                                                */
+/*-----------------------------------------------------------------------------------------------*/
+/**************************************************************************************************
+ * @brief      Constructor, detects bank swapping and where the firmware runs from
+ * @return     Nothing
+ ********************************************************************************************** */
+template <typename Part>
+STM32F4DualBankFlashAbstractionLayer<Part>::STM32F4DualBankFlashAbstractionLayer()
+  : readWhileWrite_(false) {
+  bool swapped = false;
+
+#if defined(SYSCFG_MEMRMP_UFB_MODE)
+  __HAL_RCC_SYSCFG_CLK_ENABLE();
+  swapped = (SYSCFG->MEMRMP & SYSCFG_MEMRMP_UFB_MODE) != 0U;
+#endif
+  // Swapped, the region address decodes to the first physical bank and its sector numbers
+  this->sectorIdOffset_ = swapped ? -(int32_t)(Part::sectorCount / 2U) : 0;
+
+  uint32_t code = (uint32_t)(uintptr_t)&STM32F4DualBankFlashAbstractionLayer<Part>::bankOf;
+  readWhileWrite_ = (bankOf(code) != bankOf(Part::regionBase));
+  this->sharedBank_ = !readWhileWrite_;
+}
+
+/**************************************************************************************************
+ * @brief      Destructor
+ * @return     Nothing
+ ********************************************************************************************** */
+template <typename Part>
+STM32F4DualBankFlashAbstractionLayer<Part>::~STM32F4DualBankFlashAbstractionLayer() {
+}
+
+/**************************************************************************************************
+ * @brief      Erase a region of flash memory from the flash interrupt
+ * @param      offset Starting offset to erase from (relative to flash base)
+ * @param      size Number of bytes to erase
+ * @return     Number of bytes erased if successful, negative error code otherwise
+ * @note       Waits in flash, the idle hook and all interrupts keep running meanwhile. Falls
+ *             back to the single-bank erase when the firmware runs from the region's bank.
+ ********************************************************************************************** */
+template <typename Part>
+int STM32F4DualBankFlashAbstractionLayer<Part>::erase(long offset, size_t size) {
+  if (!readWhileWrite_) {
+    return STM32F4FlashAbstractionLayer<Part>::erase(offset, size);
+  }
+
+  if (this->eraseAsync(offset, size, nullptr, nullptr) != 0) {
+    return -1;
+  }
+  return (this->waitErase() == 0) ? (int)size : -1;
+}
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private methods                                                                               */
+/*-----------------------------------------------------------------------------------------------*/
+/**
+ * @brief Bank of an address as seen in the address map
+ * @param addr Absolute address in flash
+ * @return 0 for the lower bank, 1 for the upper bank
+ */
+template <typename Part>
+uint32_t STM32F4DualBankFlashAbstractionLayer<Part>::bankOf(uint32_t addr) {
+  return (addr - Part::sectors[0].base) / Part::bankSize;
+}
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Instantiations                                                                                */
+/*-----------------------------------------------------------------------------------------------*/
+#if FAL_FLASH_RUNTIME_DETECT
+template class STM32F4DualBankFlashAbstractionLayer<STM32F429xIFlash>;
+template class STM32F4DualBankFlashAbstractionLayer<STM32F429xIFlashLarge>;
+#elif FAL_FLASH_DUAL_BANK
+template class STM32F4DualBankFlashAbstractionLayer<FAL_FLASH_PART>;
+#endif
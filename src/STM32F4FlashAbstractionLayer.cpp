@@ -22,31 +22,234 @@
 /*-----------------------------------------------------------------------------------------------*/
 #include <Arduino.h>
 #include "STM32F4FlashAbstractionLayer.h"
+#include "FalLog.h"
+#include "FlashBlankCheck.h"
+#include "FlashSectorMap.h"
+#include <lfs_util.h>
 
 /*-----------------------------------------------------------------------------------------------*/
 /* Private Defines                                                                               */
 /*-----------------------------------------------------------------------------------------------*/
-#define FLASH_SECTOR_SIZE_BYTES   (128U * 1024U)  // 128 KB sectors for STM32F401RE
-#define FLASH_TOTAL_SIZE_BYTES    (256U * 1024U)  // 256 KB for LittleFS
-#define BLOCK_SIZE_BYTES          (1024U)         // LittleFS block size
-#define LITTLE_FS_STARTIN_ADDRESS (0x08040000U)   // Sector 6 for STM32F401RE
+/* Control register program size, FLASH_PSIZE_HALF_WORD is one step of the PSIZE field */
+#define FLASH_PSIZE_FOR_WIDTH(width) (FLASH_PSIZE_HALF_WORD * (uint32_t)__builtin_ctz(width))
 
-/* Base address of the Flash sectors */
-#define ADDR_FLASH_SECTOR_0     ((uint32_t)0x08000000) /* Base @ of Sector 0, 16 Kbytes */
-#define ADDR_FLASH_SECTOR_1     ((uint32_t)0x08004000) /* Base @ of Sector 1, 16 Kbytes */
-#define ADDR_FLASH_SECTOR_2     ((uint32_t)0x08008000) /* Base @ of Sector 2, 16 Kbytes */
-#define ADDR_FLASH_SECTOR_3     ((uint32_t)0x0800C000) /* Base @ of Sector 3, 16 Kbytes */
-#define ADDR_FLASH_SECTOR_4     ((uint32_t)0x08010000) /* Base @ of Sector 4, 64 Kbytes */
-#define ADDR_FLASH_SECTOR_5     ((uint32_t)0x08020000) /* Base @ of Sector 5, 128 Kbytes */
-#define ADDR_FLASH_SECTOR_6     ((uint32_t)0x08040000) /* Base @ of Sector 6, 128 Kbytes */
-#define ADDR_FLASH_SECTOR_7     ((uint32_t)0x08060000) /* Base @ of Sector 7, 128 Kbytes */
+#define FLASH_ERROR_FLAGS       (FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR | FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR)
+#define FLASH_VERIFY_FAILED     (0x80000000U)   // Returned by ram_program next to the status flags
 
+#define RAM_VECTOR_COUNT        (128U)          // Largest vector table relocateVectorTable() can copy
+
+/* NVIC priority of the flash end-of-operation interrupt (override with -D) */
+#ifndef FAL_FLASH_IRQ_PRIORITY
+  #define FAL_FLASH_IRQ_PRIORITY (15U)
+#endif
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Variables                                                                             */
 /*-----------------------------------------------------------------------------------------------*/
-/* Global Variables                                                                              */
+static void *volatile async_erase_owner = nullptr;
+static void (*volatile async_erase_complete)(void *owner, int result) = nullptr;
+
+/* VTOR needs the table aligned to the next power of two of its size */
+static uint32_t ram_vectors[RAM_VECTOR_COUNT] __attribute__((aligned(512)));
+static_assert(sizeof(ram_vectors) <= 512U, "Raise the alignment of ram_vectors");
+
 /*-----------------------------------------------------------------------------------------------*/
-uint32_t ef_err_port_cnt = 0;
-uint32_t on_ic_write_cnt = 0;
-uint32_t on_ic_read_cnt = 0;
+/* Private Functions                                                                             */
+/*-----------------------------------------------------------------------------------------------*/
+/**
+ * @brief Copy from memory-mapped flash using word loads and LDM/STM bursts
+ * @param dst Destination buffer in RAM, any alignment
+ * @param src Source address in flash, any alignment
+ * @param size Number of bytes to copy
+ */
+static void copy_from_flash(uint8_t *dst, const uint8_t *src, size_t size) {
+  // Byte copies until the flash side is word aligned
+  while (size > 0 && ((uintptr_t)src & 3U) != 0U) {
+    *dst++ = *src++;
+    size--;
+  }
+
+  if (((uintptr_t)dst & 3U) == 0U) {
+#if defined(__arm__)
+    // 16-byte bursts keep the ART prefetch buffer streaming
+    while (size >= 16U) {
+      __asm volatile (
+        "ldmia %0!, {r3-r6} \n"
+        "stmia %1!, {r3-r6} \n"
+        : "+r" (src), "+r" (dst)
+        :
+        : "r3", "r4", "r5", "r6", "memory");
+      size -= 16U;
+    }
+#endif
+    while (size >= 4U) {
+      *(uint32_t *)dst = *(const uint32_t *)src;
+      dst += 4;
+      src += 4;
+      size -= 4U;
+    }
+  } else {
+    // Aligned word loads, unaligned stores are handled by the Cortex-M4 STR
+    while (size >= 4U) {
+      uint32_t word = *(const uint32_t *)src;
+      memcpy(dst, &word, sizeof(word));
+      dst += 4;
+      src += 4;
+      size -= 4U;
+    }
+  }
+
+  while (size > 0) {
+    *dst++ = *src++;
+    size--;
+  }
+}
+
+/**
+ * @brief Invalidate the ART data cache so reads see freshly erased or programmed flash
+ */
+static void flush_data_cache(void) {
+  if ((FLASH->ACR & FLASH_ACR_DCEN) != 0U) {
+    __HAL_FLASH_DATA_CACHE_DISABLE();
+    __HAL_FLASH_DATA_CACHE_RESET();
+    __HAL_FLASH_DATA_CACHE_ENABLE();
+  }
+}
+
+/*-----------------------------------------------------------------------------------------------*/
+/* SRAM Functions                                                                                */
+/*-----------------------------------------------------------------------------------------------*/
+/* Everything below runs while the flash is busy, so it must not call into flash resident code
+   (HAL, memcpy, logging) or use constant tables that the compiler would place in flash. */
+
+/**
+ * @brief Spin until the flash controller is idle and clear its status
+ * @return Error flags of the last operation, 0 if it succeeded
+ */
+FAL_RAMFUNC static uint32_t ram_wait_ready(void) {
+  while ((FLASH->SR & FLASH_FLAG_BSY) != 0U) {
+  }
+  uint32_t errors = FLASH->SR & FLASH_ERROR_FLAGS;
+  FLASH->SR = errors | FLASH_FLAG_EOP;
+  return errors;
+}
+
+/**
+ * @brief Program a range using the widest naturally aligned unit at each address
+ * @param addr Absolute address in flash
+ * @param src Data to program
+ * @param size Number of bytes
+ * @param maxWidth Widest program unit in bytes
+ * @param verify Read each unit back and compare it
+ * @param failAddr Receives the address of the failing unit
+ * @return 0 if successful, FLASH_VERIFY_FAILED on mismatch, error flags otherwise
+ * @note Flash must be unlocked by the caller
+ */
+FAL_RAMFUNC static uint32_t ram_program(uint32_t addr, const uint8_t *src, size_t size, uint32_t maxWidth, bool verify,
+                                        uint32_t *failAddr) {
+  uint32_t errors = ram_wait_ready();
+  size_t i = 0;
+
+  while (errors == 0U && i < size) {
+    uint32_t dst = addr + i;
+    uint32_t width = maxWidth;
+    while (width > 1U && ((dst & (width - 1U)) != 0U || (size - i) < width)) {
+      width >>= 1;
+    }
+
+    uint32_t lo = 0;
+    uint32_t hi = 0;
+    for (uint32_t b = 0; b < width; b++) {
+      if (b < 4U) {
+        lo |= (uint32_t)src[i + b] << (8U * b);
+      } else {
+        hi |= (uint32_t)src[i + b] << (8U * (b - 4U));
+      }
+    }
+
+    FLASH->CR = (FLASH->CR & ~FLASH_CR_PSIZE) | FLASH_PSIZE_FOR_WIDTH(width) | FLASH_CR_PG;
+    if (width == 8U) {
+      *(volatile uint32_t *)dst = lo;
+      __ISB();
+      *(volatile uint32_t *)(dst + 4U) = hi;
+    } else if (width == 4U) {
+      *(volatile uint32_t *)dst = lo;
+    } else if (width == 2U) {
+      *(volatile uint16_t *)dst = (uint16_t)lo;
+    } else {
+      *(volatile uint8_t *)dst = (uint8_t)lo;
+    }
+    __DSB();
+    errors = ram_wait_ready();
+    FLASH->CR &= ~FLASH_CR_PG;
+
+    if (errors == 0U && verify) {
+      for (uint32_t b = 0; b < width; b++) {
+        if (*(volatile const uint8_t *)(dst + b) != src[i + b]) {
+          errors = FLASH_VERIFY_FAILED;
+          break;
+        }
+      }
+    }
+    if (errors != 0U) {
+      *failAddr = dst;
+    }
+    i += width;
+  }
+  return errors;
+}
+
+/**
+ * @brief Erase consecutive sectors, waiting for each one without leaving SRAM
+ * @param first First sector number
+ * @param count Number of sectors
+ * @param width Program unit in bytes that selects the erase parallelism
+ * @param failSector Receives the sector that failed
+ * @return 0 if successful, error flags otherwise
+ * @note Flash must be unlocked by the caller
+ */
+FAL_RAMFUNC static uint32_t ram_erase(uint32_t first, uint32_t count, uint32_t width, uint32_t *failSector) {
+  uint32_t errors = ram_wait_ready();
+
+  for (uint32_t sector = first; errors == 0U && sector < first + count; sector++) {
+    // Sectors of the second bank are numbered from 16 in SNB (RM0090 section 3.9.8)
+    uint32_t snb = (sector > 11U) ? sector + 4U : sector;
+    FLASH->CR = (FLASH->CR & ~(FLASH_CR_PSIZE | FLASH_CR_SNB | FLASH_CR_PG)) |
+                FLASH_PSIZE_FOR_WIDTH(width) | FLASH_CR_SER | (snb << FLASH_CR_SNB_Pos);
+    FLASH->CR |= FLASH_CR_STRT;
+    __DSB();
+    errors = ram_wait_ready();
+    *failSector = sector;
+  }
+  FLASH->CR &= ~(FLASH_CR_SER | FLASH_CR_SNB);
+  return errors;
+}
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Interrupt Handlers                                                                            */
+/*-----------------------------------------------------------------------------------------------*/
+extern "C" void FLASH_IRQHandler(void) {
+  HAL_FLASH_IRQHandler();
+}
+
+/**
+ * @brief HAL callback after each erased sector, ReturnValue is 0xFFFFFFFF after the last one
+ */
+extern "C" void HAL_FLASH_EndOfOperationCallback(uint32_t ReturnValue) {
+  if (ReturnValue == 0xFFFFFFFFU && async_erase_owner != nullptr) {
+    async_erase_complete(async_erase_owner, 0);
+  }
+}
+
+/**
+ * @brief HAL callback when an interrupt-driven operation fails, ReturnValue is the sector
+ */
+extern "C" void HAL_FLASH_OperationErrorCallback(uint32_t ReturnValue) {
+  FAL_TRACE(FAL_TRACE_ERROR, ReturnValue, HAL_FLASH_GetError());
+  if (async_erase_owner != nullptr) {
+    async_erase_complete(async_erase_owner, -1);
+  }
+}
 
 /*-----------------------------------------------------------------------------------------------*/
 /* Public methods                                                                                */
@@ -55,14 +258,28 @@ uint32_t on_ic_read_cnt = 0;
  * @brief      Constructor for the STM32F4 Flash Abstraction Layer
  * @return     Nothing
  ********************************************************************************************** */
-STM32F4FlashAbstractionLayer::STM32F4FlashAbstractionLayer() {
+template <typename Part>
+STM32F4FlashAbstractionLayer<Part>::STM32F4FlashAbstractionLayer()
+  : sectorIdOffset_(0), sharedBank_(regionInFirmwareBank), eraseState_(0), eraseStart_(0), eraseCallback_(nullptr), eraseContext_(nullptr), idleHook_(nullptr),
+    verifyPolicy_(FAL_VERIFY_POLICY), pendingCount_(0), wbWindow_(-1), wbLo_(0), wbHi_(0), stats_(regionSectors) {
 }
 
 /**************************************************************************************************
  * @brief      Destructor
  * @return     Nothing
  ********************************************************************************************** */
-STM32F4FlashAbstractionLayer::~STM32F4FlashAbstractionLayer() {
+template <typename Part>
+STM32F4FlashAbstractionLayer<Part>::~STM32F4FlashAbstractionLayer() {
+  // Buffered writes are programmed like in sync(), an error here has no caller to report to
+  if (flushWriteBack() != 0) {
+    FAL_LOG_ERROR("Buffered writes lost on destruction");
+  }
+
+  // The flash interrupt must not call back into a destroyed layer
+  waitErase();
+  if (async_erase_owner == this) {
+    async_erase_owner = nullptr;
+  }
 }
 
 /**************************************************************************************************
@@ -70,88 +287,186 @@ STM32F4FlashAbstractionLayer::~STM32F4FlashAbstractionLayer() {
  * @param      offset Starting offset to erase from (relative to flash base)
  * @param      size Number of bytes to erase
  * @return     Number of bytes erased if successful, negative error code otherwise
+ * @note       With an idle hook set the erase runs from the interrupt and the hook is called
+ *             until it completes, otherwise the CPU waits in an SRAM loop where only
+ *             FAL_RAMFUNC interrupt handlers keep running. When the region shares a bank with
+ *             the firmware there is never a hook (see setIdleHook()), the application is
+ *             stalled for the whole 1-2 s sector erase except for those handlers.
  ********************************************************************************************** */
-int STM32F4FlashAbstractionLayer::erase(long offset, size_t size) {
-  uint32_t FirstSector = 0, NbOfSectors = 0;
+template <typename Part>
+int STM32F4FlashAbstractionLayer<Part>::erase(long offset, size_t size) {
   uint32_t SECTORError = 0;
   FLASH_EraseInitTypeDef EraseInitStruct;
-  long addr = LITTLE_FS_STARTIN_ADDRESS + offset;
+  uint32_t start = FalStatsRecorder::cycles();
 
-  Serial.print("Erasing offset: 0x"); Serial.println(offset, HEX);
-  Serial.print("Erase size: "); Serial.println(size);
-  Serial.print("First sector: "); Serial.println(getSectorFromOffset(addr));
-  Serial.print("Number of sectors: "); Serial.println(getSectorFromOffset(addr + size - 1) - getSectorFromOffset(addr) + 1);
+  if (idleHook_ != nullptr && !sharedBank_) {
+    if (eraseAsync(offset, size, nullptr, nullptr) != 0) {
+      return -1;
+    }
+    return (waitErase() == 0) ? (int)size : -1;
+  }
 
-  // Validate offset and size
-  if (offset < 0 || offset >= FLASH_TOTAL_SIZE_BYTES || size == 0 || (offset + size) > FLASH_TOTAL_SIZE_BYTES) {
-    Serial.println("Error: Invalid erase offset or size");
-    ef_err_port_cnt++;
+  // A running asynchronous erase ends first, its result already went to pollErase() and the callback
+  waitErase();
+  int prepared = prepareErase(offset, size, &EraseInitStruct);
+  if (prepared < 0) {
     return -1;
   }
+  if (prepared > 0) {
+    stats_.complete(FAL_STATS_ERASE, start);
+    return (int)size;
+  }
 
   HAL_FLASH_Unlock();
   __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR | FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR);
 
-  FirstSector = getSectorFromOffset(addr);
-  NbOfSectors = getSectorFromOffset(addr + size - 1) - FirstSector + 1;
-  EraseInitStruct.TypeErase = FLASH_TYPEERASE_SECTORS;
-  EraseInitStruct.VoltageRange = FLASH_VOLTAGE_RANGE_3;
-  EraseInitStruct.Sector = FirstSector;
-  EraseInitStruct.NbSectors = NbOfSectors;
-
-  if (HAL_FLASHEx_Erase(&EraseInitStruct, &SECTORError) != HAL_OK) {
-    Serial.print("Erase failed, HAL error: "); Serial.println(HAL_FLASH_GetError());
-    ef_err_port_cnt++;
+  uint32_t errors = ram_erase(EraseInitStruct.Sector, EraseInitStruct.NbSectors, Part::programWidth, &SECTORError);
+  if (errors != 0U) {
+    FAL_TRACE(FAL_TRACE_ERROR, SECTORError, errors);
+    FAL_LOG_ERROR("Erase of sector %lu failed, status: 0x%08lX", (unsigned long)SECTORError, (unsigned long)errors);
+    stats_.error(FAL_STATS_ERR_ERASE);
+    flush_data_cache();
     HAL_FLASH_Lock();
     return -1;
   }
 
+  flush_data_cache();
   HAL_FLASH_Lock();
+  stats_.complete(FAL_STATS_ERASE, start);
   return size;
 }
 
 /**************************************************************************************************
- * @brief      Write data to flash memory
- * @param      offset Offset to write to (relative to flash base)
- * @param      buf Pointer to the data to write
- * @param      size Number of bytes to write
- * @return     Number of bytes written if successful, negative error code otherwise
+ * @brief      Start erasing a region of flash memory from the flash interrupt
+ * @param      offset Starting offset to erase from (relative to flash base)
+ * @param      size Number of bytes to erase
+ * @param      cb Called from the interrupt with the result, may be nullptr
+ * @param      ctx Passed through to cb
+ * @return     0 if the erase was started, negative error code otherwise
  ********************************************************************************************** */
-int STM32F4FlashAbstractionLayer::write(long offset, const uint8_t *buf, size_t size) {
-  long addr = LITTLE_FS_STARTIN_ADDRESS + offset;
-
-  Serial.print("Writing offset: 0x"); Serial.println(offset, HEX);
-  Serial.print("Write size: "); Serial.println(size);
+template <typename Part>
+int STM32F4FlashAbstractionLayer<Part>::eraseAsync(long offset, size_t size, FalCompletionCallback cb, void *ctx) {
+  FLASH_EraseInitTypeDef EraseInitStruct;
+  uint32_t start = FalStatsRecorder::cycles();
 
-  // Validate offset and size
-  if (offset < 0 || offset >= FLASH_TOTAL_SIZE_BYTES || size == 0 || (offset + size) > FLASH_TOTAL_SIZE_BYTES) {
-    Serial.println("Error: Invalid write offset or size");
-    ef_err_port_cnt++;
+  if (eraseState_ == FAL_BUSY) {
+    FAL_LOG_ERROR("Erase already in progress");
+    stats_.error(FAL_STATS_ERR_BUSY);
+    return -1;
+  }
+  int prepared = prepareErase(offset, size, &EraseInitStruct);
+  if (prepared < 0) {
     return -1;
   }
+  if (prepared > 0) {
+    // Already blank, complete without touching the controller
+    FAL_TRACE(FAL_TRACE_ERASE_DONE, 0, 0);
+    stats_.complete(FAL_STATS_ERASE, start);
+    eraseState_ = 0;
+    if (cb != nullptr) {
+      cb(ctx, 0);
+    }
+    return 0;
+  }
+
+  async_erase_owner = this;
+  async_erase_complete = &STM32F4FlashAbstractionLayer<Part>::onEraseComplete;
+  eraseCallback_ = cb;
+  eraseContext_ = ctx;
+  eraseStart_ = start;
+  eraseState_ = FAL_BUSY;
 
+  HAL_NVIC_SetPriority(FLASH_IRQn, FAL_FLASH_IRQ_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(FLASH_IRQn);
   HAL_FLASH_Unlock();
   __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR | FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR);
 
-  for (size_t i = 0; i < size; i++) {
-    if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_BYTE, addr + i, buf[i]) != HAL_OK) {
-      Serial.print("Write failed, HAL error: "); Serial.println(HAL_FLASH_GetError());
-      ef_err_port_cnt++;
-      HAL_FLASH_Lock();
-      return -1;
-    }
-    // Verify written data
-    if (*(uint8_t*)(addr + i) != buf[i]) {
-      Serial.println("Write verification failed");
-      ef_err_port_cnt++;
-      HAL_FLASH_Lock();
-      return -1;
+  if (HAL_FLASHEx_Erase_IT(&EraseInitStruct) != HAL_OK) {
+    FAL_LOG_ERROR("Erase start failed, HAL error: %lu", (unsigned long)HAL_FLASH_GetError());
+    async_erase_owner = nullptr;
+    eraseState_ = -1;
+    stats_.error(FAL_STATS_ERR_ERASE);
+    HAL_FLASH_Lock();
+    return -1;
+  }
+  return 0;
+}
+
+/**************************************************************************************************
+ * @brief      Poll the asynchronous erase
+ * @return     FAL_BUSY while running, then 0 if successful or a negative error code
+ ********************************************************************************************** */
+template <typename Part>
+int STM32F4FlashAbstractionLayer<Part>::pollErase() {
+  return eraseState_;
+}
+
+/**************************************************************************************************
+ * @brief      Set the function erase() calls while waiting, nullptr for blocking erases
+ * @param      hook Idle function, e.g. servicing sensors and communication
+ * @return     Nothing
+ * @note       Refused when the region shares a bank with the firmware (every single-bank part):
+ *             the hook, the wait loop and the flash interrupt would all fetch from the bank
+ *             being erased and stall anyway, so erases keep waiting in SRAM instead
+ ********************************************************************************************** */
+template <typename Part>
+void STM32F4FlashAbstractionLayer<Part>::setIdleHook(void (*hook)(void)) {
+  if (hook != nullptr && sharedBank_) {
+    FAL_LOG_WARN("Idle hook ignored, the firmware runs from the bank being erased");
+    idleHook_ = nullptr;
+    return;
+  }
+  idleHook_ = hook;
+}
+
+/**************************************************************************************************
+ * @brief      Wait for the asynchronous erase, calling the idle hook meanwhile
+ * @return     0 if successful or no erase was running, negative error code otherwise
+ ********************************************************************************************** */
+template <typename Part>
+int STM32F4FlashAbstractionLayer<Part>::waitErase(void) {
+  while (eraseState_ == FAL_BUSY) {
+    if (idleHook_ != nullptr) {
+      idleHook_();
     }
   }
+  return eraseState_;
+}
 
+/**************************************************************************************************
+ * @brief      Finish the asynchronous erase, called from the flash interrupt
+ * @param      result 0 if every sector was erased, negative error code otherwise
+ * @return     Nothing
+ ********************************************************************************************** */
+template <typename Part>
+void STM32F4FlashAbstractionLayer<Part>::completeErase(int result) {
+  flush_data_cache();
   HAL_FLASH_Lock();
-  on_ic_write_cnt++;
-  return size;
+  if (result != 0) {
+    stats_.error(FAL_STATS_ERR_ERASE);
+  } else {
+    stats_.complete(FAL_STATS_ERASE, eraseStart_);
+  }
+  FAL_TRACE(FAL_TRACE_ERASE_DONE, 0, result);
+
+  async_erase_owner = nullptr;
+  eraseState_ = result;
+  if (eraseCallback_ != nullptr) {
+    eraseCallback_(eraseContext_, result);
+  }
+}
+
+/**************************************************************************************************
+ * @brief      Write data to flash memory
+ * @param      offset Offset to write to (relative to flash base)
+ * @param      buf Pointer to the data to write
+ * @param      size Number of bytes to write
+ * @return     Number of bytes written if successful, negative error code otherwise
+ ********************************************************************************************** */
+template <typename Part>
+int STM32F4FlashAbstractionLayer<Part>::write(long offset, const uint8_t *buf, size_t size) {
+  FlashIoSegment segment = { offset, (void *)buf, size };
+  return writev(&segment, 1);
 }
 
 /**************************************************************************************************
@@ -161,39 +476,186 @@ int STM32F4FlashAbstractionLayer::write(long offset, const uint8_t *buf, size_t
  * @param      size Number of bytes to read
  * @return     Number of bytes read if successful, negative error code otherwise
  ********************************************************************************************** */
-int STM32F4FlashAbstractionLayer::read(long offset, uint8_t *buf, size_t size) {
-  size_t i;
-  long addr = LITTLE_FS_STARTIN_ADDRESS + offset;
+template <typename Part>
+int STM32F4FlashAbstractionLayer<Part>::read(long offset, uint8_t *buf, size_t size) {
+  FlashIoSegment segment = { offset, buf, size };
+  return readv(&segment, 1);
+}
 
-  Serial.print("Reading offset: 0x"); Serial.println(offset, HEX);
-  Serial.print("Read size: "); Serial.println(size);
+/**************************************************************************************************
+ * @brief      Write several ranges within one unlock window
+ * @param      segs Segments to program, data is the source
+ * @param      count Number of segments
+ * @return     Total bytes written if successful, negative error code otherwise
+ * @note       Every segment is validated before the first one is programmed. With
+ *             FAL_WRITE_BACK_SIZE set the data is only buffered until sync() or a window change.
+ ********************************************************************************************** */
+template <typename Part>
+int STM32F4FlashAbstractionLayer<Part>::writev(const FlashIoSegment *segs, size_t count) {
+  uint32_t start = FalStatsRecorder::cycles();
+  size_t total = 0;
 
   // Validate offset and size
-  if (!buf || size == 0) {
-    Serial.println("Error: Invalid read buffer or size");
-    ef_err_port_cnt++;
-    return -1;
+  for (size_t i = 0; i < count; i++) {
+    FAL_TRACE(FAL_TRACE_WRITE, segs[i].offset, segs[i].size);
+    if (!validRange(segs[i].offset, segs[i].size) || segs[i].data == nullptr) {
+      FAL_LOG_ERROR("Invalid write offset 0x%lX or size %u", (unsigned long)segs[i].offset, (unsigned)segs[i].size);
+      stats_.error(FAL_STATS_ERR_RANGE);
+      return -1;
+    }
+    total += segs[i].size;
   }
 
-  if (offset < 0 || offset >= FLASH_TOTAL_SIZE_BYTES || (offset + size) > FLASH_TOTAL_SIZE_BYTES) {
-    Serial.println("Error: Invalid read offset or size");
-    ef_err_port_cnt++;
+  if (FAL_WRITE_BACK_SIZE == 0U) {
+    int result = programSegments(segs, count);
+    if (result >= 0) {
+      stats_.complete(FAL_STATS_WRITE, start);
+    }
+    return result;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    const uint8_t *src = (const uint8_t *)segs[i].data;
+    uint32_t offset = (uint32_t)segs[i].offset;
+    uint32_t end = offset + segs[i].size;
+
+    while (offset < end) {
+      uint32_t window = offset & ~(FAL_WRITE_BACK_SIZE - 1U);
+      if ((int32_t)window != wbWindow_) {
+        int err = loadWriteBack(window);
+        if (err != 0) {
+          return err;
+        }
+      }
+      uint32_t lo = offset - window;
+      uint32_t n = (end - offset < FAL_WRITE_BACK_SIZE - lo) ? end - offset : FAL_WRITE_BACK_SIZE - lo;
+      memcpy(&wbData_[lo], src, n);
+      wbLo_ = (lo < wbLo_) ? lo : wbLo_;
+      wbHi_ = (lo + n > wbHi_) ? lo + n : wbHi_;
+      src += n;
+      offset += n;
+    }
+  }
+  stats_.complete(FAL_STATS_WRITE, start);
+  return (int)total;
+}
+
+/**
+ * @brief Program validated segments within one unlock window
+ * @param segs Segments to program, data is the source
+ * @param count Number of segments
+ * @return Total bytes written if successful, negative error code otherwise
+ */
+template <typename Part>
+int STM32F4FlashAbstractionLayer<Part>::programSegments(const FlashIoSegment *segs, size_t count) {
+  size_t total = 0;
+
+  // Programming is not possible while an erase is running, its result is not this call's
+  waitErase();
+  for (size_t i = 0; i < count; i++) {
+    total += segs[i].size;
+  }
+
+  HAL_FLASH_Unlock();
+  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR | FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR);
+
+  // Unaligned head bytes, then the aligned middle at full program width, then the tail bytes
+  uint32_t failAddr = 0;
+  uint32_t errors = 0;
+  size_t done = 0;
+  while (done < count && errors == 0U) {
+    errors = ram_program(Part::regionBase + segs[done].offset, (const uint8_t *)segs[done].data, segs[done].size,
+                         Part::programWidth, verifyPolicy_ == FAL_VERIFY_CHUNK, &failAddr);
+    done++;
+  }
+
+  flush_data_cache();
+  HAL_FLASH_Lock();
+
+  if (errors == FLASH_VERIFY_FAILED) {
+    FAL_TRACE(FAL_TRACE_ERROR, failAddr, 0);
+    FAL_LOG_ERROR("Write verification failed at 0x%08lX", (unsigned long)failAddr);
+    stats_.error(FAL_STATS_ERR_VERIFY);
+    return FAL_ERR_CORRUPT;
+  }
+  if (errors != 0U) {
+    FAL_TRACE(FAL_TRACE_ERROR, failAddr, errors);
+    FAL_LOG_ERROR("Write failed at 0x%08lX, status: 0x%08lX", (unsigned long)failAddr, (unsigned long)errors);
+    stats_.error(FAL_STATS_ERR_PROGRAM);
     return -1;
   }
 
-  for (i = 0; i < size; i++, buf++, addr++) {
-    *buf = *(uint8_t *)addr;
+  if (verifyPolicy_ == FAL_VERIFY_SYNC) {
+    for (size_t i = 0; i < count; i++) {
+      int err = recordPending(Part::regionBase + segs[i].offset, (const uint8_t *)segs[i].data, segs[i].size);
+      if (err != 0) {
+        return err;
+      }
+    }
   }
-  on_ic_read_cnt++;
-  return size;
+  stats_.programmed(total);
+  return (int)total;
+}
+
+/**************************************************************************************************
+ * @brief      Read several ranges after a single wait for the erase
+ * @param      segs Segments to read, data is the destination
+ * @param      count Number of segments
+ * @return     Total bytes read if successful, negative error code otherwise
+ ********************************************************************************************** */
+template <typename Part>
+int STM32F4FlashAbstractionLayer<Part>::readv(const FlashIoSegment *segs, size_t count) {
+  uint32_t start = FalStatsRecorder::cycles();
+  size_t total = 0;
+
+  // Validate offset and size
+  for (size_t i = 0; i < count; i++) {
+    FAL_TRACE(FAL_TRACE_READ, segs[i].offset, segs[i].size);
+    if (!validRange(segs[i].offset, segs[i].size) || segs[i].data == nullptr) {
+      FAL_LOG_ERROR("Invalid read offset 0x%lX or size %u", (unsigned long)segs[i].offset, (unsigned)segs[i].size);
+      stats_.error(FAL_STATS_ERR_RANGE);
+      return -1;
+    }
+    total += segs[i].size;
+  }
+
+  // Reads would stall the bus until the erase ends, wait cooperatively instead
+  waitErase();
+  for (size_t i = 0; i < count; i++) {
+    copy_from_flash((uint8_t *)segs[i].data, (const uint8_t *)(Part::regionBase + segs[i].offset), segs[i].size);
+
+    // The buffered window holds flash plus the writes not yet programmed
+    if (wbWindow_ >= 0) {
+      uint32_t lo = (uint32_t)segs[i].offset;
+      uint32_t hi = lo + segs[i].size;
+      uint32_t wlo = (uint32_t)wbWindow_;
+      uint32_t whi = wlo + FAL_WRITE_BACK_SIZE;
+      if (lo < whi && hi > wlo) {
+        uint32_t from = (lo > wlo) ? lo : wlo;
+        uint32_t to = (hi < whi) ? hi : whi;
+        memcpy((uint8_t *)segs[i].data + (from - lo), &wbData_[from - wlo], to - from);
+      }
+    }
+  }
+  stats_.read(total);
+  stats_.complete(FAL_STATS_READ, start);
+  return (int)total;
 }
 
 /**************************************************************************************************
  * @brief      Commit all buffered write operations to flash memory
  * @return     0 if successful, negative error code otherwise
+ * @note       Programs the write-back window, then checks the FAL_VERIFY_SYNC ranges
  ********************************************************************************************** */
-int STM32F4FlashAbstractionLayer::sync() {
-  return 0; // No buffering, direct writes
+template <typename Part>
+int STM32F4FlashAbstractionLayer<Part>::sync() {
+  uint32_t start = FalStatsRecorder::cycles();
+  int err = flushWriteBack();
+  int verified = verifyPending();
+  if (err == 0 && verified == 0) {
+    stats_.complete(FAL_STATS_SYNC, start);
+  }
+  return (err != 0) ? err : verified;
 }
 
 /**************************************************************************************************
@@ -202,48 +664,308 @@ int STM32F4FlashAbstractionLayer::sync() {
  * @param      size Size to check
  * @return     True if erased (all 0xFF), false otherwise
  ********************************************************************************************** */
-bool STM32F4FlashAbstractionLayer::verify_flash_erased(uint32_t addr, size_t size) {
-  for (size_t i = 0; i < size; i++) {
-    if (*(uint8_t*)(addr + i) != 0xFF) {
-      Serial.print("Flash not erased at 0x"); Serial.println(addr + i, HEX);
-      ef_err_port_cnt++;
-      return false;
-    }
+template <typename Part>
+bool STM32F4FlashAbstractionLayer<Part>::verify_flash_erased(uint32_t addr, size_t size) {
+  FlashBlankCheckResult result;
+
+  flushWriteBack();
+  if (!FlashBlankCheck::scan((const void *)addr, size, false, &result)) {
+    FAL_LOG_WARN("Flash not erased at 0x%08lX, %lu dirty words",
+                 (unsigned long)(addr + result.firstDirty), (unsigned long)result.dirtyWords);
+    stats_.error(FAL_STATS_ERR_NOT_BLANK);
+    return false;
   }
   return true;
 }
 
+/**************************************************************************************************
+ * @brief      Copy the active vector table to SRAM and point VTOR at the copy
+ * @return     Nothing
+ * @note       Exception entry reads the handler address from the table, so a table in flash
+ *             would stall FAL_RAMFUNC handlers for the whole erase just like flash code
+ ********************************************************************************************** */
+template <typename Part>
+void STM32F4FlashAbstractionLayer<Part>::relocateVectorTable(void) {
+  const uint32_t *active = (const uint32_t *)(uintptr_t)SCB->VTOR;
+
+  if (active == ram_vectors) {
+    return;
+  }
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  static_assert(Part::vectorCount <= RAM_VECTOR_COUNT, "Vector table does not fit ram_vectors");
+  for (uint32_t i = 0; i < Part::vectorCount; i++) {
+    ram_vectors[i] = active[i];
+  }
+  SCB->VTOR = (uint32_t)(uintptr_t)ram_vectors;
+  __DSB();
+  __ISB();
+  __set_PRIMASK(primask);
+}
+
+/**************************************************************************************************
+ * @brief      Get a direct pointer into the memory-mapped LittleFS region
+ * @param      offset Offset of the range (relative to flash base)
+ * @param      size Size of the range
+ * @return     Pointer to the first byte, nullptr if the range is invalid
+ ********************************************************************************************** */
+template <typename Part>
+const uint8_t *STM32F4FlashAbstractionLayer<Part>::map(long offset, size_t size) {
+  if (offset < 0 || offset >= Part::regionSize || (offset + size) > Part::regionSize) {
+    return nullptr;
+  }
+  // The pointer bypasses the write-back buffer
+  if (flushWriteBack() != 0) {
+    return nullptr;
+  }
+  return (const uint8_t *)(Part::regionBase + offset);
+}
+
 /*-----------------------------------------------------------------------------------------------*/
 /* Private methods                                                                               */
 /*-----------------------------------------------------------------------------------------------*/
+/**************************************************************************************************
+ * @brief      Select how programmed data is verified
+ * @param      policy FAL_VERIFY_NONE, FAL_VERIFY_CHUNK or FAL_VERIFY_SYNC
+ * @return     Nothing
+ * @note       Ranges still pending from FAL_VERIFY_SYNC are checked at the next sync()
+ ********************************************************************************************** */
+template <typename Part>
+void STM32F4FlashAbstractionLayer<Part>::setVerifyPolicy(FalVerifyPolicy policy) {
+  verifyPolicy_ = policy;
+}
+
+/**************************************************************************************************
+ * @brief      Copy the I/O statistics
+ * @param      out Destination
+ * @return     True unless statistics are compiled out with FAL_STATS_ENABLED=0
+ ********************************************************************************************** */
+template <typename Part>
+bool STM32F4FlashAbstractionLayer<Part>::getStats(FalStats *out) const {
+  stats_.snapshot(out);
+  return FAL_STATS_ENABLED != 0;
+}
+
+/**************************************************************************************************
+ * @brief      Clear the I/O statistics
+ * @return     Nothing
+ ********************************************************************************************** */
+template <typename Part>
+void STM32F4FlashAbstractionLayer<Part>::resetStats() {
+  stats_.reset();
+}
+
+/**************************************************************************************************
+ * @brief      Validate an erase request and fill the HAL erase descriptor
+ * @param      offset Starting offset to erase from (relative to flash base)
+ * @param      size Number of bytes to erase
+ * @param      init Receives the sector range, trimmed to the sectors that are not blank
+ * @return     0 if the range is valid, 1 if every sector is already blank, -1 otherwise
+ ********************************************************************************************** */
+template <typename Part>
+int STM32F4FlashAbstractionLayer<Part>::prepareErase(long offset, size_t size, FLASH_EraseInitTypeDef *init) {
+  long addr = Part::regionBase + offset;
+
+  FAL_TRACE(FAL_TRACE_ERASE, offset, size);
+
+  // Validate offset and size
+  if (offset < 0 || offset >= Part::regionSize || size == 0 || (offset + size) > Part::regionSize) {
+    FAL_LOG_ERROR("Invalid erase offset 0x%lX or size %u", (unsigned long)offset, (unsigned)size);
+    stats_.error(FAL_STATS_ERR_RANGE);
+    return -1;
+  }
+
+  // Look the range up once, the HAL sector numbers are derived from the map indices
+  int32_t first = flashSectorIndex(Part::sectors, Part::sectorCount, (uint32_t)addr);
+  int32_t last = flashSectorIndex(Part::sectors, Part::sectorCount, (uint32_t)(addr + size - 1));
+  if (first < 0 || last < 0) {
+    FAL_LOG_ERROR("Erase range 0x%08lX+%u is outside the sector map", (unsigned long)addr, (unsigned)size);
+    stats_.error(FAL_STATS_ERR_RANGE);
+    return -1;
+  }
+  int32_t FirstSector = (int32_t)Part::sectors[first].id + sectorIdOffset_;
+  int32_t LastSector = (int32_t)Part::sectors[last].id + sectorIdOffset_;
+  FAL_TRACE(FAL_TRACE_SECTOR_LOOKUP, addr, FirstSector);
+  FAL_TRACE(FAL_TRACE_SECTOR_LOOKUP, addr + size - 1, LastSector);
+
+  // The hardware erases whole sectors, so everything below refers to their full span
+  uint32_t spanStart = Part::sectors[first].base;
+  uint32_t spanEnd = Part::sectors[last].base + Part::sectors[last].size;
+
+  // Buffered writes into the erased sectors are dropped, any other window is programmed first
+  if (wbWindow_ >= 0) {
+    uint32_t window = Part::regionBase + (uint32_t)wbWindow_;
+    if (window >= spanStart && window < spanEnd) {
+      wbWindow_ = -1;
+    } else if (flushWriteBack() != 0) {
+      return -1;
+    }
+  }
+
+  // Sectors that are already blank at either end need no erase cycle
+  while (first <= last && FlashBlankCheck::isBlank((const void *)Part::sectors[first].base, Part::sectors[first].size)) {
+    first++;
+  }
+  while (last >= first && FlashBlankCheck::isBlank((const void *)Part::sectors[last].base, Part::sectors[last].size)) {
+    last--;
+  }
+  if (first > last) {
+    FAL_LOG_DEBUG("Sectors %ld to %ld already blank", (long)FirstSector, (long)LastSector);
+    return 1;
+  }
+  FirstSector = (int32_t)Part::sectors[first].id + sectorIdOffset_;
+  LastSector = (int32_t)Part::sectors[last].id + sectorIdOffset_;
+
+  // Ranges about to be erased can no longer be verified
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < pendingCount_; i++) {
+    if (pending_[i].addr + pending_[i].size <= spanStart || pending_[i].addr >= spanEnd) {
+      pending_[kept++] = pending_[i];
+    }
+  }
+  pendingCount_ = kept;
+
+  // Count the wear when the erase is issued, a failed erase still cycles the sector
+  for (int32_t i = first; i <= last; i++) {
+    stats_.erased((uint32_t)(i - regionFirstIndex), Part::sectors[i].size);
+  }
+
+  init->TypeErase = FLASH_TYPEERASE_SECTORS;
+  init->VoltageRange = (uint32_t)__builtin_ctz(Part::programWidth);  // FLASH_VOLTAGE_RANGE_1..4 select x8..x64
+  init->Sector = FirstSector;
+  init->NbSectors = LastSector - FirstSector + 1;
+  FAL_LOG_DEBUG("Erasing sectors %ld to %ld", (long)FirstSector, (long)LastSector);
+  return 0;
+}
+
+/**************************************************************************************************
+ * @brief      Compare the CRC of every range written under FAL_VERIFY_SYNC with flash
+ * @return     0 if all ranges match, FAL_ERR_CORRUPT otherwise
+ ********************************************************************************************** */
+template <typename Part>
+int STM32F4FlashAbstractionLayer<Part>::verifyPending(void) {
+  int err = 0;
+
+  for (uint32_t i = 0; i < pendingCount_; i++) {
+    const PendingVerify *range = &pending_[i];
+    if (lfs_crc(0xFFFFFFFFU, (const void *)range->addr, range->size) != range->crc) {
+      FAL_TRACE(FAL_TRACE_ERROR, range->addr, range->size);
+      FAL_LOG_ERROR("Write verification failed in 0x%08lX+%lu", (unsigned long)range->addr, (unsigned long)range->size);
+      stats_.error(FAL_STATS_ERR_VERIFY);
+      err = FAL_ERR_CORRUPT;
+    }
+  }
+  pendingCount_ = 0;
+  return err;
+}
+
+/**
+ * @brief Check that a non-empty range lies inside the LittleFS region
+ * @param offset Offset relative to the region
+ * @param size Number of bytes
+ * @return True if the range is valid
+ */
+template <typename Part>
+bool STM32F4FlashAbstractionLayer<Part>::validRange(long offset, size_t size) {
+  return offset >= 0 && size != 0 && (uint32_t)offset < Part::regionSize && size <= Part::regionSize - (uint32_t)offset;
+}
+
 /**
- * @brief Get the flash sector from the given address
+ * @brief Remember a written range for FAL_VERIFY_SYNC
  * @param addr Absolute address in flash
- * @return Flash sector number
+ * @param buf Data that was programmed
+ * @param size Number of bytes
+ * @return 0 if successful, FAL_ERR_CORRUPT if an early verification failed
  */
-uint32_t STM32F4FlashAbstractionLayer::getSectorFromOffset(uint32_t addr) {
-  uint32_t sector = 0;
-
-  Serial.print("Address: 0x"); Serial.println(addr, HEX);
-
-  if ((addr < ADDR_FLASH_SECTOR_1) && (addr >= ADDR_FLASH_SECTOR_0)) {
-    sector = FLASH_SECTOR_0;
-  } else if ((addr < ADDR_FLASH_SECTOR_2) && (addr >= ADDR_FLASH_SECTOR_1)) {
-    sector = FLASH_SECTOR_1;
-  } else if ((addr < ADDR_FLASH_SECTOR_3) && (addr >= ADDR_FLASH_SECTOR_2)) {
-    sector = FLASH_SECTOR_2;
-  } else if ((addr < ADDR_FLASH_SECTOR_4) && (addr >= ADDR_FLASH_SECTOR_3)) {
-    sector = FLASH_SECTOR_3;
-  } else if ((addr < ADDR_FLASH_SECTOR_5) && (addr >= ADDR_FLASH_SECTOR_4)) {
-    sector = FLASH_SECTOR_4;
-  } else if ((addr < ADDR_FLASH_SECTOR_6) && (addr >= ADDR_FLASH_SECTOR_5)) {
-    sector = FLASH_SECTOR_5;
-  } else if ((addr < ADDR_FLASH_SECTOR_7) && (addr >= ADDR_FLASH_SECTOR_6)) {
-    sector = FLASH_SECTOR_6;
-  } else {
-    sector = FLASH_SECTOR_7;
+template <typename Part>
+int STM32F4FlashAbstractionLayer<Part>::recordPending(uint32_t addr, const uint8_t *buf, size_t size) {
+  // Extend the previous range when LittleFS programs sequentially, the CRC simply continues
+  PendingVerify *last = (pendingCount_ > 0) ? &pending_[pendingCount_ - 1U] : nullptr;
+  if (last != nullptr && last->addr + last->size == addr) {
+    last->crc = lfs_crc(last->crc, buf, size);
+    last->size += size;
+    return 0;
+  }
+  if (pendingCount_ == FAL_VERIFY_PENDING_MAX) {
+    int err = verifyPending();
+    if (err != 0) {
+      return err;
+    }
+  }
+  pending_[pendingCount_].addr = addr;
+  pending_[pendingCount_].size = size;
+  pending_[pendingCount_].crc = lfs_crc(0xFFFFFFFFU, buf, size);
+  pendingCount_++;
+  return 0;
+}
+
+/**
+ * @brief Make a window the buffered one, programming the previous window first
+ * @param window Region offset of the window, aligned to FAL_WRITE_BACK_SIZE
+ * @return 0 if successful, negative error code otherwise
+ */
+template <typename Part>
+int STM32F4FlashAbstractionLayer<Part>::loadWriteBack(uint32_t window) {
+  int err = flushWriteBack();
+  if (err != 0) {
+    return err;
   }
 
-  Serial.print("Sector: "); Serial.println(sector);
-  return sector;
-}
\ No newline at end of file
+  // Unwritten bytes keep their flash content, so padding to the program width rewrites them as is
+  waitErase();
+  copy_from_flash(wbData_, (const uint8_t *)(Part::regionBase + window), FAL_WRITE_BACK_SIZE);
+  wbWindow_ = (int32_t)window;
+  wbLo_ = FAL_WRITE_BACK_SIZE;
+  wbHi_ = 0;
+  return 0;
+}
+
+/**
+ * @brief Program the dirty part of the buffered window, widened to the program width
+ * @return 0 if successful or nothing was buffered, negative error code otherwise
+ */
+template <typename Part>
+int STM32F4FlashAbstractionLayer<Part>::flushWriteBack(void) {
+  if (wbWindow_ < 0 || wbHi_ <= wbLo_) {
+    return 0;
+  }
+
+  uint32_t lo = wbLo_ & ~(Part::programWidth - 1U);
+  uint32_t hi = (wbHi_ + Part::programWidth - 1U) & ~(Part::programWidth - 1U);
+  FlashIoSegment segment = { (long)wbWindow_ + (long)lo, &wbData_[lo], hi - lo };
+
+  wbLo_ = FAL_WRITE_BACK_SIZE;
+  wbHi_ = 0;
+  int result = programSegments(&segment, 1);
+  if (result < 0) {
+    wbWindow_ = -1;
+    return result;
+  }
+  return 0;
+}
+
+/**
+ * @brief Trampoline stored for the flash interrupt, which does not know the part
+ * @param self FAL that started the erase
+ * @param result 0 if every sector was erased, negative error code otherwise
+ */
+template <typename Part>
+void STM32F4FlashAbstractionLayer<Part>::onEraseComplete(void *self, int result) {
+  static_cast<STM32F4FlashAbstractionLayer<Part> *>(self)->completeErase(result);
+}
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Instantiations                                                                                */
+/*-----------------------------------------------------------------------------------------------*/
+#if FAL_FLASH_RUNTIME_DETECT
+template class STM32F4FlashAbstractionLayer<STM32F401xEFlash>;
+template class STM32F4FlashAbstractionLayer<STM32F401xEFlashLarge>;
+template class STM32F4FlashAbstractionLayer<STM32F411xEFlash>;
+template class STM32F4FlashAbstractionLayer<STM32F411xEFlashLarge>;
+template class STM32F4FlashAbstractionLayer<STM32F446xEFlash>;
+template class STM32F4FlashAbstractionLayer<STM32F446xEFlashLarge>;
+template class STM32F4FlashAbstractionLayer<STM32F429xIFlash>;
+template class STM32F4FlashAbstractionLayer<STM32F429xIFlashLarge>;
+#else
+template class STM32F4FlashAbstractionLayer<FAL_FLASH_PART>;
+#endif
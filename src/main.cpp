@@ -23,29 +23,36 @@
 #include <Arduino.h>
 #include <lfs.h>
 #include "FlashAbstractionLayerFactory.h"
+#include "FlashTranslationLayer.h"
+#include "STM32F4FlashAbstractionLayer.h"
+#include "LfsFalBinding.h"
+#include "LfsRtos.h"
+#include "LfsProfile.h"
+#include "FalLog.h"
 
 /*-----------------------------------------------------------------------------------------------*/
 /* Global Variables                                                                              */
 /*-----------------------------------------------------------------------------------------------*/
-IFlashAbstractionLayer *fal = FlashAbstractionLayerFactory::createFlashAbstractionLayer();
+FlashGeometry geometry;
+FalDefaultLayer *fal = static_cast<FalDefaultLayer *>(FlashAbstractionLayerFactory::createFlashAbstractionLayer(&geometry));
+FlashTranslationLayer<FalDefaultLayer> ftl(fal, geometry.sectorSize, geometry.sectorCount, geometry.blockSize);
 lfs_t lfs;
-extern uint32_t ef_err_port_cnt;  // Error counter for flash operations
-extern uint32_t on_ic_write_cnt;  // Counter for successful write operations
-extern uint32_t on_ic_read_cnt;   // Counter for successful read operations
+static struct lfs_config cfg;  // Filled in setup(), lfs keeps a pointer to it while mounted
 
 /*-----------------------------------------------------------------------------------------------*/
 /* Private Functions                                                                             */
 /*-----------------------------------------------------------------------------------------------*/
 int erase_littlefs_region() {
-    // Erase 256 KB (sectors 6–7)
-    int err = fal->erase(0, 256 * 1024);
+    // Erase the whole region chosen by the factory
+    uint32_t size = geometry.sectorSize * geometry.sectorCount;
+    int err = fal->erase(0, size);
     if (err < 0) {
       Serial.println("Error: Failed to erase LittleFS region");
       return err;
     }
   
     // Verify the erased state
-    if (! fal->verify_flash_erased(0x08040000, 256 * 1024)) {
+    if (! fal->verify_flash_erased(geometry.regionBase, size)) {
       Serial.println("Error: Flash verification failed");
       return -1;
     }
@@ -53,60 +60,95 @@ int erase_littlefs_region() {
     Serial.println("LittleFS region erased and verified");
     return 0;
   }
-int erase(const struct lfs_config *c, lfs_block_t block) {
-  long offset = block * c->block_size;
-  int result = fal->erase(offset, c->block_size);
-  return (result >= 0) ? 0 : -1; // STM32F4FlashAbstractionLayer::erase returns size or -1
-}
-
-int sync(const struct lfs_config *c) {
-  return fal->sync();
-}
 
-int write(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size) {
-  long offset = (block * c->block_size) + off;
-  int result = fal->write(offset, (const uint8_t*)buffer, size);
-  return (result == size) ? 0 : -1;
-}
+void print_flash_stats() {
+    static const char *const ops[] = { "read", "write", "erase", "sync" };
+    FalStats stats;
+    if (! fal->getStats(&stats)) {
+      return;
+    }
 
-int read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size) {
-  long offset = (block * c->block_size) + off;
-  int result = fal->read(offset, (uint8_t*)buffer, size);
-  return (result == size) ? 0 : -1;
-}
+    Serial.print("Bytes read/programmed/erased: "); Serial.print((unsigned long)stats.bytesRead);
+    Serial.print(" / "); Serial.print((unsigned long)stats.bytesProgrammed);
+    Serial.print(" / "); Serial.println((unsigned long)stats.bytesErased);
+    for (int op = 0; op < FAL_STATS_OP_COUNT; op++) {
+      const FalLatency *lat = &stats.latency[op];
+      Serial.print(ops[op]); Serial.print(": "); Serial.print(lat->count); Serial.print(" ops");
+      if (lat->count != 0) {
+        Serial.print(", us min/avg/max "); Serial.print(lat->min / stats.cyclesPerMicrosecond);
+        Serial.print(" / "); Serial.print(lat->average() / stats.cyclesPerMicrosecond);
+        Serial.print(" / "); Serial.print(lat->max / stats.cyclesPerMicrosecond);
+      }
+      Serial.println();
+    }
+    Serial.print("Errors (range/busy/program/verify/erase/blank):");
+    for (int cause = 0; cause < FAL_STATS_ERR_COUNT; cause++) {
+      Serial.print(" "); Serial.print(stats.errors[cause]);
+    }
+    Serial.println();
+    Serial.print("Sector erases:");
+    for (uint32_t i = 0; i < stats.sectorCount; i++) {
+      Serial.print(" "); Serial.print(stats.sectorErases[i]);
+    }
+    Serial.println();
+  }
 
 /*-----------------------------------------------------------------------------------------------*/
 /* Setup                                                                                         */
 /*-----------------------------------------------------------------------------------------------*/
 void setup() {
-lfs_file_t file;
-const struct lfs_config cfg = {
-    .read = read,
-    .prog = write,
-    .erase = erase,
-    .sync = sync,
-    .read_size = 16,
-    .prog_size = 1,
-    .block_size = 1024,
-    .block_count = 256,
-    .block_cycles = 500,
-    .cache_size = 256,
-    .lookahead_size = 16,
-  };
+  lfs_file_t file;
+  FlashAbstractionLayerFactory::tuneConfig(&geometry, &cfg);
+  LfsFalBinding<FlashTranslationLayer<FalDefaultLayer>>::bind(&ftl, &cfg);
+  cfg.block_count = ftl.logicalBlockCount();
+  cfg.block_cycles = 500;
+#if FAL_RTOS_ENABLED && defined(LFS_THREADSAFE)
+  LfsRtos::begin();
+  LfsRtos::bind(&cfg);
+#endif
   Serial.begin(9600);
   while (!Serial) {} // Wait for serial
   Serial.println("STM32F401RE LittleFS Demo");
   Serial.println("========================================");
+
+  if (fal == nullptr) {
+    Serial.print("Unsupported device 0x"); Serial.print(geometry.deviceId, HEX);
+    Serial.print(" with "); Serial.print(geometry.flashSize / 1024); Serial.println(" KB flash");
+    return;
+  }
+  Serial.print("Device: 0x"); Serial.print(geometry.deviceId, HEX);
+  Serial.print(", region: 0x"); Serial.print(geometry.regionBase, HEX);
+  Serial.print(" + "); Serial.print(geometry.sectorCount); Serial.print(" x ");
+  Serial.print(geometry.sectorSize / 1024); Serial.println(" KB");
   
   Serial.print("System clock: "); Serial.print(SystemCoreClock / 1000000); Serial.println(" MHz");
   Serial.print("Flash latency: "); Serial.println((FLASH->ACR & FLASH_ACR_LATENCY) >> FLASH_ACR_LATENCY_Pos);
   Serial.println("Note: Skipping write protection check as confirmed disabled in STM32CubeProgrammer");
 
+  // Keep the application running while sectors are erased from the flash interrupt. That only
+  // works with the region in the other bank, a single-bank part erases from an SRAM loop where
+  // just FAL_RAMFUNC handlers run, reached through a vector table copied to SRAM.
+#if FAL_FLASH_DUAL_BANK
+#if FAL_RTOS_ENABLED
+  fal->setIdleHook(LfsRtos::idleHook);
+#else
+  fal->setIdleHook(yield);
+#endif
+#elif !FAL_FLASH_RUNTIME_DETECT
+  STM32F4FlashAbstractionLayer<FAL_FLASH_PART>::relocateVectorTable();
+#endif
+
   // Erase LittleFS region
   if (erase_littlefs_region() != 0) {
     Serial.println("Setup aborted due to erase failure");
     return;
   }
+
+  // Rebuild the logical block map
+  if (ftl.mount() != 0) {
+    Serial.println("Setup aborted due to translation layer mount failure");
+    return;
+  }
   
   // Mount filesystem
   int err = lfs_mount(&lfs, &cfg);
@@ -195,14 +237,16 @@ const struct lfs_config cfg = {
     Serial.print("Unmount failed, error: "); Serial.println(err);
     return;
   }
-  Serial.print("Read operations: "); Serial.println(on_ic_read_cnt);
-  Serial.print("Write operations: "); Serial.println(on_ic_write_cnt);
-  Serial.print("Port errors: "); Serial.println(ef_err_port_cnt);
+  print_flash_stats();
+#ifdef LFS_PROFILE
+  LfsProfile::dumpCsv();
+#endif
 }
 
 /*-----------------------------------------------------------------------------------------------*/
 /* Loop                                                                                          */
 /*-----------------------------------------------------------------------------------------------*/
 void loop() {
+  FalTrace::drain();
   delay(1000);
 }
\ No newline at end of file
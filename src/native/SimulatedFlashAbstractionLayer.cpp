@@ -0,0 +1,353 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : SimulatedFlashAbstractionLayer.cpp
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : Host-native simulation of STM32F4 internal flash with a datasheet timing model
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : native
+ * @compiler : gcc
+ *
+ **************************************************************************************************
+ *
+ */
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Includes                                                                                      */
+/*-----------------------------------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include "SimulatedFlashAbstractionLayer.h"
+#include "FalLog.h"
+#include "FlashBlankCheck.h"
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Public methods                                                                                */
+/*-----------------------------------------------------------------------------------------------*/
+/**************************************************************************************************
+ * @brief      Constructor, the region starts out erased
+ * @param      timing Timing model, nullptr for the datasheet values of the part
+ ********************************************************************************************** */
+template <typename Part>
+SimulatedFlashAbstractionLayer<Part>::SimulatedFlashAbstractionLayer(const SimulatedFlashTiming *timing)
+  : mem_((uint8_t *)malloc(Part::regionSize)),
+    timing_((timing != nullptr) ? *timing : datasheetTiming(Part::programWidth)),
+    elapsedNs_(0),
+    conflicts_(0),
+    operations_(0),
+    cutAfter_(0),
+    seed_(1),
+    powerLost_(false),
+    stats_(regionSectors) {
+  if (mem_ != nullptr) {
+    memset(mem_, 0xFF, Part::regionSize);
+  }
+}
+
+/**************************************************************************************************
+ * @brief      Destructor
+ ********************************************************************************************** */
+template <typename Part>
+SimulatedFlashAbstractionLayer<Part>::~SimulatedFlashAbstractionLayer() {
+  free(mem_);
+}
+
+/**************************************************************************************************
+ * @brief      Erase every sector touched by a range
+ * @param      offset Starting offset to erase from (relative to the region)
+ * @param      size Number of bytes to erase
+ * @return     Number of bytes erased if successful, negative error code otherwise
+ * @note       Sectors that are already blank are skipped like in the STM32F4 FAL, costing only
+ *             the time of the blank check
+ ********************************************************************************************** */
+template <typename Part>
+int SimulatedFlashAbstractionLayer<Part>::erase(long offset, size_t size) {
+  if (powerLost_) {
+    return -1;
+  }
+  if (mem_ == nullptr || !validRange(offset, size)) {
+    FAL_LOG_ERROR("Invalid erase offset 0x%lX or size %u", (unsigned long)offset, (unsigned)size);
+    stats_.error(FAL_STATS_ERR_RANGE);
+    return -1;
+  }
+
+  uint64_t start = elapsedNs_;
+  int32_t first = flashSectorIndex(Part::sectors, Part::sectorCount, Part::regionBase + (uint32_t)offset);
+  int32_t last = flashSectorIndex(Part::sectors, Part::sectorCount, Part::regionBase + (uint32_t)offset + size - 1U);
+  int32_t torn = tearNow() ? first + (int32_t)tornLength((uint32_t)(last - first + 1)) : last + 1;
+  for (int32_t i = first; i <= last; i++) {
+    if (i == torn) {
+      memset(mem_ + (Part::sectors[i].base - Part::regionBase), 0xFF, tornLength(Part::sectors[i].size));
+      return -1;
+    }
+    uint8_t *sector = mem_ + (Part::sectors[i].base - Part::regionBase);
+    FlashBlankCheckResult blank;
+    if (FlashBlankCheck::scan(sector, Part::sectors[i].size, true, &blank)) {
+      elapsedNs_ += (uint64_t)(Part::sectors[i].size / 4U) * timing_.readWordNs;
+      continue;
+    }
+    elapsedNs_ += (uint64_t)(blank.firstDirty / 4U + 1U) * timing_.readWordNs + eraseTimeNs(Part::sectors[i].size);
+    memset(sector, 0xFF, Part::sectors[i].size);
+    stats_.erased((uint32_t)(i - regionFirstIndex), Part::sectors[i].size);
+  }
+  stats_.sample(FAL_STATS_ERASE, (uint32_t)(elapsedNs_ - start));
+  return (int)size;
+}
+
+/**************************************************************************************************
+ * @brief      Program data, clearing bits only
+ * @param      offset Offset to write to (relative to the region)
+ * @param      buf Pointer to the data to write
+ * @param      size Number of bytes to write
+ * @return     Number of bytes written if successful, negative error code otherwise
+ * @note       Time is charged per program unit, using the widest aligned unit at each address
+ *             like the STM32F4 FAL
+ ********************************************************************************************** */
+template <typename Part>
+int SimulatedFlashAbstractionLayer<Part>::write(long offset, const uint8_t *buf, size_t size) {
+  if (powerLost_) {
+    return -1;
+  }
+  if (mem_ == nullptr || buf == nullptr || !validRange(offset, size)) {
+    FAL_LOG_ERROR("Invalid write offset 0x%lX or size %u", (unsigned long)offset, (unsigned)size);
+    stats_.error(FAL_STATS_ERR_RANGE);
+    return -1;
+  }
+
+  uint64_t start = elapsedNs_;
+  bool torn = tearNow();
+  size_t limit = torn ? tornLength((uint32_t)size) : size;
+  size_t i = 0;
+  while (i < limit) {
+    uint32_t dst = (uint32_t)offset + i;
+    uint32_t width = Part::programWidth;
+    while (width > 1U && ((dst & (width - 1U)) != 0U || (size - i) < width)) {
+      width >>= 1;
+    }
+    for (uint32_t b = 0; b < width; b++) {
+      uint8_t cell = mem_[dst + b];
+      if ((cell & buf[i + b]) != buf[i + b]) {
+        conflicts_++;
+        FAL_LOG_DEBUG("Program of 0x%02X over 0x%02X at 0x%08lX cannot set bits", (unsigned)buf[i + b],
+                      (unsigned)cell, (unsigned long)(Part::regionBase + dst + b));
+      }
+      mem_[dst + b] = cell & buf[i + b];
+    }
+    elapsedNs_ += timing_.programNs;
+    i += width;
+  }
+  if (torn) {
+    return -1;
+  }
+  stats_.programmed(size);
+  stats_.sample(FAL_STATS_WRITE, (uint32_t)(elapsedNs_ - start));
+  return (int)size;
+}
+
+/**************************************************************************************************
+ * @brief      Read data from the simulated flash
+ * @param      offset Offset to read from (relative to the region)
+ * @param      buf Pointer to buffer to store read data
+ * @param      size Number of bytes to read
+ * @return     Number of bytes read if successful, negative error code otherwise
+ ********************************************************************************************** */
+template <typename Part>
+int SimulatedFlashAbstractionLayer<Part>::read(long offset, uint8_t *buf, size_t size) {
+  if (powerLost_) {
+    return -1;
+  }
+  if (mem_ == nullptr || buf == nullptr || !validRange(offset, size)) {
+    FAL_LOG_ERROR("Invalid read offset 0x%lX or size %u", (unsigned long)offset, (unsigned)size);
+    stats_.error(FAL_STATS_ERR_RANGE);
+    return -1;
+  }
+
+  memcpy(buf, mem_ + offset, size);
+  uint32_t elapsed = (uint32_t)((size + 3U) / 4U) * timing_.readWordNs;
+  elapsedNs_ += elapsed;
+  stats_.read(size);
+  stats_.sample(FAL_STATS_READ, elapsed);
+  return (int)size;
+}
+
+/**************************************************************************************************
+ * @brief      Nothing is buffered, every write is already in the image
+ * @return     0, -1 after a power loss
+ ********************************************************************************************** */
+template <typename Part>
+int SimulatedFlashAbstractionLayer<Part>::sync() {
+  if (powerLost_) {
+    return -1;
+  }
+  stats_.sample(FAL_STATS_SYNC, 0);
+  return 0;
+}
+
+/**************************************************************************************************
+ * @brief      Verify flash is erased
+ * @param      addr Absolute start address, as on the target
+ * @param      size Size to check
+ * @return     True if erased (all 0xFF), false otherwise
+ ********************************************************************************************** */
+template <typename Part>
+bool SimulatedFlashAbstractionLayer<Part>::verify_flash_erased(uint32_t addr, size_t size) {
+  if (powerLost_) {
+    return false;
+  }
+  if (mem_ == nullptr || addr < Part::regionBase || !validRange((long)(addr - Part::regionBase), size)) {
+    stats_.error(FAL_STATS_ERR_RANGE);
+    return false;
+  }
+  elapsedNs_ += (uint64_t)((size + 3U) / 4U) * timing_.readWordNs;
+  if (!FlashBlankCheck::isBlank(mem_ + (addr - Part::regionBase), size)) {
+    stats_.error(FAL_STATS_ERR_NOT_BLANK);
+    return false;
+  }
+  return true;
+}
+
+/**************************************************************************************************
+ * @brief      Get a direct pointer into the simulated region
+ * @param      offset Offset of the range (relative to the region)
+ * @param      size Size of the range
+ * @return     Pointer to the first byte, nullptr if the range is invalid or power is lost
+ ********************************************************************************************** */
+template <typename Part>
+const uint8_t *SimulatedFlashAbstractionLayer<Part>::map(long offset, size_t size) {
+  if (powerLost_ || mem_ == nullptr || !validRange(offset, size)) {
+    return nullptr;
+  }
+  return mem_ + offset;
+}
+
+/**************************************************************************************************
+ * @brief      Copy the I/O statistics, latencies are simulated nanoseconds
+ * @param      out Destination
+ * @return     True unless statistics are compiled out with FAL_STATS_ENABLED=0
+ ********************************************************************************************** */
+template <typename Part>
+bool SimulatedFlashAbstractionLayer<Part>::getStats(FalStats *out) const {
+  stats_.snapshot(out);
+  return FAL_STATS_ENABLED != 0;
+}
+
+/**************************************************************************************************
+ * @brief      Clear the I/O statistics
+ * @return     Nothing
+ ********************************************************************************************** */
+template <typename Part>
+void SimulatedFlashAbstractionLayer<Part>::resetStats() {
+  stats_.reset();
+}
+
+/**************************************************************************************************
+ * @brief      Arm a power loss
+ * @param      operations The power fails during this program or erase from now, 1 for the next
+ *             one, 0 disarms
+ * @param      seed Picks how much of the interrupted operation reaches the cells
+ * @return     Nothing
+ ********************************************************************************************** */
+template <typename Part>
+void SimulatedFlashAbstractionLayer<Part>::cutPowerAfter(uint32_t operations, uint32_t seed) {
+  cutAfter_ = operations;
+  seed_ = (seed != 0U) ? seed : 1U;
+}
+
+/**************************************************************************************************
+ * @brief      Typical times of the STM32F401xE datasheet
+ * @param      programWidth Program unit in bytes, selects the erase parallelism
+ * @return     Timing model
+ ********************************************************************************************** */
+template <typename Part>
+SimulatedFlashTiming SimulatedFlashAbstractionLayer<Part>::datasheetTiming(uint32_t programWidth) {
+  SimulatedFlashTiming timing;
+
+  timing.programNs = 16000U;
+  timing.readWordNs = 12U;
+  if (programWidth == 1U) {
+    timing.erase16KNs = 400000000U;
+    timing.erase64KNs = 1200000000U;
+    timing.erase128KNs = 2000000000U;
+  } else if (programWidth == 2U) {
+    timing.erase16KNs = 300000000U;
+    timing.erase64KNs = 700000000U;
+    timing.erase128KNs = 1300000000U;
+  } else {
+    // x64 needs external Vpp, without it the part erases at x32 speed
+    timing.erase16KNs = 250000000U;
+    timing.erase64KNs = 550000000U;
+    timing.erase128KNs = 1000000000U;
+  }
+  return timing;
+}
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private methods                                                                               */
+/*-----------------------------------------------------------------------------------------------*/
+/**
+ * @brief Check that a non-empty range lies inside the LittleFS region
+ * @param offset Offset relative to the region
+ * @param size Number of bytes
+ * @return True if the range is valid
+ */
+template <typename Part>
+bool SimulatedFlashAbstractionLayer<Part>::validRange(long offset, size_t size) {
+  return offset >= 0 && size != 0 && (uint32_t)offset < Part::regionSize && size <= Part::regionSize - (uint32_t)offset;
+}
+
+/**
+ * @brief Erase time of one sector
+ * @param sectorSize Size of the sector in bytes
+ * @return Nanoseconds
+ */
+template <typename Part>
+uint32_t SimulatedFlashAbstractionLayer<Part>::eraseTimeNs(uint32_t sectorSize) const {
+  if (sectorSize <= 16U * 1024U) {
+    return timing_.erase16KNs;
+  }
+  return (sectorSize <= 64U * 1024U) ? timing_.erase64KNs : timing_.erase128KNs;
+}
+
+/**
+ * @brief Count a program or erase and check whether the armed power loss hits it
+ * @return True if the operation is interrupted, powerLost_ is then set
+ */
+template <typename Part>
+bool SimulatedFlashAbstractionLayer<Part>::tearNow(void) {
+  operations_++;
+  if (cutAfter_ == 0U || --cutAfter_ != 0U) {
+    return false;
+  }
+  powerLost_ = true;
+  return true;
+}
+
+/**
+ * @brief Pick how much of an interrupted operation completed (xorshift32 on the seed)
+ * @param size Size of the operation, non-zero
+ * @return Pseudo-random length in [0, size)
+ */
+template <typename Part>
+uint32_t SimulatedFlashAbstractionLayer<Part>::tornLength(uint32_t size) {
+  seed_ ^= seed_ << 13;
+  seed_ ^= seed_ >> 17;
+  seed_ ^= seed_ << 5;
+  return seed_ % size;
+}
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Instantiations                                                                                */
+/*-----------------------------------------------------------------------------------------------*/
+template class SimulatedFlashAbstractionLayer<STM32F401xEFlash>;
+template class SimulatedFlashAbstractionLayer<STM32F401xEFlashLarge>;
+template class SimulatedFlashAbstractionLayer<STM32F411xEFlash>;
+template class SimulatedFlashAbstractionLayer<STM32F411xEFlashLarge>;
+template class SimulatedFlashAbstractionLayer<STM32F446xEFlash>;
+template class SimulatedFlashAbstractionLayer<STM32F446xEFlashLarge>;
+template class SimulatedFlashAbstractionLayer<STM32F429xIFlash>;
+template class SimulatedFlashAbstractionLayer<STM32F429xIFlashLarge>;
@@ -0,0 +1,287 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : main.cpp
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : Host benchmark of LittleFS on the simulated STM32F4 flash
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : native
+ * @compiler : gcc
+ *
+ **************************************************************************************************
+ *
+ * Runs the on-target demo workload plus a logging workload against the simulated flash and
+ * prints the simulated flash time and I/O statistics. Usage:
+ *
+ *   pio run -e native -t exec -a "<block size> <files> <bytes per file> <chunk> <read caches>
+ *                                 <fetch caches> <path caches> <positions>"
+ *
+ * Every argument is optional, block size 0 keeps the smallest block the translation layer allows.
+ * read caches, fetch caches and path caches set lfs_config::read_cache_count, fetch_cache_count
+ * and dentry_cache_count, positions sets lfs_file_config::ctz_cache_count for random reads.
+ * Each must stay 0 unless its cache is compiled in (LFS_READ_CACHE, LFS_FETCH_CACHE,
+ * LFS_DENTRY_CACHE and LFS_CTZ_CACHE, the native environment defines them).
+ *
+ */
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Includes                                                                                      */
+/*-----------------------------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lfs.h>
+#include "FlashAbstractionLayerFactory.h"
+#include "FlashTranslationLayer.h"
+#include "LfsFalBinding.h"
+#include "SimulatedFlashAbstractionLayer.h"
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Defines                                                                               */
+/*-----------------------------------------------------------------------------------------------*/
+#define BENCH_FILES_DEFAULT      (4U)
+#define BENCH_FILE_SIZE_DEFAULT  (8U * 1024U)
+#define BENCH_CHUNK_DEFAULT      (64U)
+#define BENCH_CHUNK_MAX          (4096U)
+#define BENCH_STAT_ROUNDS        (100U)
+#define BENCH_SEEK_READS         (200U)      // Random reads per file
+#define BENCH_SEEK_SIZE          (16U)
+
+// Largest count each optional LittleFS cache accepts, 0 if compiled out
+#ifdef LFS_READ_CACHE
+#define BENCH_READ_CACHES_MAX    LFS_READ_CACHE_MAX
+#else
+#define BENCH_READ_CACHES_MAX    (0U)
+#endif
+#ifdef LFS_FETCH_CACHE
+#define BENCH_FETCH_CACHES_MAX   LFS_FETCH_CACHE_MAX
+#else
+#define BENCH_FETCH_CACHES_MAX   (0U)
+#endif
+#ifdef LFS_DENTRY_CACHE
+#define BENCH_PATH_CACHES_MAX    LFS_DENTRY_CACHE_MAX
+#else
+#define BENCH_PATH_CACHES_MAX    (0U)
+#endif
+
+typedef SimulatedFlashAbstractionLayer<FAL_FLASH_PART> SimulatedFlash;
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Functions                                                                             */
+/*-----------------------------------------------------------------------------------------------*/
+/**
+ * @brief Print the simulated time of a phase and restart the clock
+ */
+static void report_phase(SimulatedFlash *flash, const char *name) {
+  printf("%-10s %10.3f ms simulated\n", name, (double)flash->elapsedNs() / 1e6);
+  flash->resetTime();
+}
+
+/**
+ * @brief Print the I/O statistics of the simulated flash
+ */
+static void report_stats(IFlashAbstractionLayer *fal) {
+  static const char *const ops[] = { "read", "write", "erase", "sync" };
+  FalStats stats;
+  if (!fal->getStats(&stats)) {
+    return;
+  }
+
+  printf("bytes read %llu, programmed %llu, erased %llu\n", (unsigned long long)stats.bytesRead,
+         (unsigned long long)stats.bytesProgrammed, (unsigned long long)stats.bytesErased);
+  for (int op = 0; op < FAL_STATS_OP_COUNT; op++) {
+    const FalLatency *lat = &stats.latency[op];
+    printf("%-6s %8lu ops", ops[op], (unsigned long)lat->count);
+    if (lat->count != 0) {
+      printf(", us min/avg/max %lu / %lu / %lu", (unsigned long)(lat->min / stats.cyclesPerMicrosecond),
+             (unsigned long)(lat->average() / stats.cyclesPerMicrosecond),
+             (unsigned long)(lat->max / stats.cyclesPerMicrosecond));
+    }
+    printf("\n");
+  }
+  printf("sector erases:");
+  for (uint32_t i = 0; i < stats.sectorCount; i++) {
+    printf(" %lu", (unsigned long)stats.sectorErases[i]);
+  }
+  printf("\n");
+}
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Main                                                                                          */
+/*-----------------------------------------------------------------------------------------------*/
+int main(int argc, char **argv) {
+  uint32_t blockSize = (argc > 1) ? (uint32_t)strtoul(argv[1], nullptr, 0) : 0U;
+  uint32_t files = (argc > 2) ? (uint32_t)strtoul(argv[2], nullptr, 0) : BENCH_FILES_DEFAULT;
+  uint32_t fileSize = (argc > 3) ? (uint32_t)strtoul(argv[3], nullptr, 0) : BENCH_FILE_SIZE_DEFAULT;
+  uint32_t chunk = (argc > 4) ? (uint32_t)strtoul(argv[4], nullptr, 0) : BENCH_CHUNK_DEFAULT;
+  uint32_t readCaches = (argc > 5) ? (uint32_t)strtoul(argv[5], nullptr, 0) : 0U;
+  uint32_t fetchCaches = (argc > 6) ? (uint32_t)strtoul(argv[6], nullptr, 0) : 0U;
+  uint32_t pathCaches = (argc > 7) ? (uint32_t)strtoul(argv[7], nullptr, 0) : 0U;
+  uint32_t positions = (argc > 8) ? (uint32_t)strtoul(argv[8], nullptr, 0) : 0U;
+  static uint8_t data[BENCH_CHUNK_MAX];
+
+  if (chunk == 0U || chunk > BENCH_CHUNK_MAX) {
+    fprintf(stderr, "chunk must be 1..%u bytes\n", (unsigned)BENCH_CHUNK_MAX);
+    return 1;
+  }
+  if (readCaches > BENCH_READ_CACHES_MAX || fetchCaches > BENCH_FETCH_CACHES_MAX || pathCaches > BENCH_PATH_CACHES_MAX) {
+    fprintf(stderr, "read caches must be 0..%u, fetch caches 0..%u, path caches 0..%u\n",
+            (unsigned)BENCH_READ_CACHES_MAX, (unsigned)BENCH_FETCH_CACHES_MAX, (unsigned)BENCH_PATH_CACHES_MAX);
+    return 1;
+  }
+#ifndef LFS_CTZ_CACHE
+  if (positions != 0U) {
+    fprintf(stderr, "positions need LFS_CTZ_CACHE\n");
+    return 1;
+  }
+#endif
+
+  FlashGeometry geometry;
+  IFlashAbstractionLayer *fal = FlashAbstractionLayerFactory::createFlashAbstractionLayer(&geometry);
+  SimulatedFlash *flash = static_cast<SimulatedFlash *>(fal);
+  if (blockSize != 0U) {
+    geometry.blockSize = blockSize;
+  }
+  FlashTranslationLayer<SimulatedFlash> ftl(flash, geometry.sectorSize, geometry.sectorCount, geometry.blockSize);
+
+  struct lfs_config cfg = {};
+  FlashAbstractionLayerFactory::tuneConfig(&geometry, &cfg);
+  LfsFalBinding<FlashTranslationLayer<SimulatedFlash>>::bind(&ftl, &cfg);
+  cfg.block_count = ftl.logicalBlockCount();
+  cfg.block_cycles = 500;
+#ifdef LFS_READ_CACHE
+  cfg.read_cache_count = readCaches;
+#endif
+#ifdef LFS_FETCH_CACHE
+  cfg.fetch_cache_count = fetchCaches;
+#endif
+#ifdef LFS_DENTRY_CACHE
+  cfg.dentry_cache_count = pathCaches;
+#endif
+  printf("region 0x%08lX: %lu x %lu KB sectors, %lu blocks of %lu bytes\n", (unsigned long)geometry.regionBase,
+         (unsigned long)geometry.sectorCount, (unsigned long)(geometry.sectorSize / 1024U),
+         (unsigned long)cfg.block_count, (unsigned long)cfg.block_size);
+
+  lfs_t lfs;
+  if (ftl.format() != 0 || ftl.mount() != 0 || lfs_format(&lfs, &cfg) != 0 || lfs_mount(&lfs, &cfg) != 0) {
+    fprintf(stderr, "format failed, geometry not supported\n");
+    return 1;
+  }
+  report_phase(flash, "format");
+
+  // Append every file chunk by chunk, interleaved like concurrent loggers
+  lfs_file_t file;
+  char name[16];
+  for (uint32_t done = 0; done < fileSize; done += chunk) {
+    uint32_t n = (fileSize - done < chunk) ? fileSize - done : chunk;
+    for (uint32_t f = 0; f < files; f++) {
+      memset(data, (int)(f + done), n);
+      snprintf(name, sizeof(name), "log%lu", (unsigned long)f);
+      int err = lfs_file_open(&lfs, &file, name, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND);
+      if (err == 0) {
+        lfs_ssize_t written = lfs_file_write(&lfs, &file, data, n);
+        err = lfs_file_close(&lfs, &file);
+        err = (written < 0) ? (int)written : err;
+      }
+      if (err != 0) {
+        fprintf(stderr, "append to %s at %lu failed: %d\n", name, (unsigned long)done, err);
+        return 1;
+      }
+    }
+  }
+  report_phase(flash, "append");
+
+  // Read everything back and check the pattern
+  for (uint32_t f = 0; f < files; f++) {
+    snprintf(name, sizeof(name), "log%lu", (unsigned long)f);
+    if (lfs_file_open(&lfs, &file, name, LFS_O_RDONLY) != 0) {
+      fprintf(stderr, "open %s failed\n", name);
+      return 1;
+    }
+    for (uint32_t done = 0; done < fileSize; done += chunk) {
+      uint32_t n = (fileSize - done < chunk) ? fileSize - done : chunk;
+      if (lfs_file_read(&lfs, &file, data, n) != (lfs_ssize_t)n || data[0] != (uint8_t)(f + done) ||
+          data[n - 1U] != (uint8_t)(f + done)) {
+        fprintf(stderr, "%s corrupt at %lu\n", name, (unsigned long)done);
+        return 1;
+      }
+    }
+    lfs_file_close(&lfs, &file);
+  }
+  report_phase(flash, "readback");
+
+  // Read short records at random positions, like table lookups
+  struct lfs_file_config fileCfg = {};
+#ifdef LFS_CTZ_CACHE
+  fileCfg.ctz_cache_count = positions;
+#endif
+  uint32_t seed = 1U;
+  uint32_t records = (fileSize < BENCH_SEEK_SIZE) ? 0U : fileSize - BENCH_SEEK_SIZE + 1U;
+  for (uint32_t f = 0; f < files && records != 0U; f++) {
+    snprintf(name, sizeof(name), "log%lu", (unsigned long)f);
+    if (lfs_file_opencfg(&lfs, &file, name, LFS_O_RDONLY, &fileCfg) != 0) {
+      fprintf(stderr, "open %s failed\n", name);
+      return 1;
+    }
+    for (uint32_t r = 0; r < BENCH_SEEK_READS; r++) {
+      seed = seed * 1103515245U + 12345U;
+      uint32_t at = (seed >> 8) % records;
+      if (lfs_file_seek(&lfs, &file, (lfs_soff_t)at, LFS_SEEK_SET) < 0 ||
+          lfs_file_read(&lfs, &file, data, BENCH_SEEK_SIZE) != (lfs_ssize_t)BENCH_SEEK_SIZE ||
+          data[0] != (uint8_t)(f + at / chunk * chunk)) {
+        fprintf(stderr, "%s corrupt at %lu\n", name, (unsigned long)at);
+        return 1;
+      }
+    }
+    lfs_file_close(&lfs, &file);
+  }
+  report_phase(flash, "seek");
+
+  // Stat every file over and over, nothing changes in between
+  struct lfs_info info;
+  for (uint32_t round = 0; round < BENCH_STAT_ROUNDS; round++) {
+    for (uint32_t f = 0; f < files; f++) {
+      snprintf(name, sizeof(name), "log%lu", (unsigned long)f);
+      if (lfs_stat(&lfs, name, &info) != 0 || info.size != fileSize) {
+        fprintf(stderr, "stat %s failed\n", name);
+        return 1;
+      }
+    }
+  }
+  report_phase(flash, "stat");
+
+  // Remove every other file, freeing blocks scattered over all sectors
+  for (uint32_t f = 0; f < files; f += 2U) {
+    snprintf(name, sizeof(name), "log%lu", (unsigned long)f);
+    if (lfs_remove(&lfs, name) != 0) {
+      fprintf(stderr, "remove %s failed\n", name);
+      return 1;
+    }
+  }
+  report_phase(flash, "remove");
+
+#ifdef LFS_CACHESTAT
+  struct lfs_cachestat cache;
+  lfs_fs_cachestat(&lfs, &cache);
+#endif
+  lfs_unmount(&lfs);
+  report_stats(fal);
+#ifdef LFS_CACHESTAT
+  printf("read caches %lu: %lu hits, %lu misses\n", (unsigned long)(readCaches + 1U),
+         (unsigned long)cache.rcache_hits, (unsigned long)cache.rcache_misses);
+  printf("fetch caches %lu: %lu hits, %lu misses\n", (unsigned long)fetchCaches,
+         (unsigned long)cache.fetch_hits, (unsigned long)cache.fetch_misses);
+  printf("path caches %lu: %lu hits, %lu misses\n", (unsigned long)pathCaches,
+         (unsigned long)cache.dentry_hits, (unsigned long)cache.dentry_misses);
+  printf("positions %lu: %lu hits, %lu misses\n", (unsigned long)positions, (unsigned long)cache.ctz_hits,
+         (unsigned long)cache.ctz_misses);
+#endif
+  printf("program conflicts %lu\n", (unsigned long)flash->programConflicts());
+  delete fal;
+  return 0;
+}
@@ -0,0 +1,564 @@
+/*
+ **************************************************************************************************
+ *
+ * @file    : main.cpp
+ * @author  : Oussama Darouez
+ * @version : 1.0
+ * @date    : July 2025
+ * @brief   : Host power-loss fuzzer for LittleFS on the translation layer and simulated flash
+ *
+ **************************************************************************************************
+ *
+ * @project  : stm32_littlefs
+ * @board    : native
+ * @compiler : gcc
+ *
+ **************************************************************************************************
+ *
+ * Replays the boot flow of the on-target demo (boot_count, txts/myfile.txt) plus a log append
+ * and a whole-file rewrite for a number of boots, and cuts power during the Nth program or
+ * erase for every N the workload reaches. After each cut the translation layer and LittleFS
+ * are remounted and every file must hold either the state before or after the operation that
+ * was interrupted. One more boot then runs to completion and is checked after a clean remount.
+ * Cut points are shared out over one thread per core. Usage:
+ *
+ *   pio run -e native_powerloss -t exec -a "<stride> <threads> <boots> <first cut>"
+ *
+ * stride 1 cuts at every operation, threads 0 uses every core. A failure prints its cut point,
+ * rerun from it with stride and threads 1 to reproduce it alone.
+ *
+ */
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Includes                                                                                      */
+/*-----------------------------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <lfs.h>
+#include "FlashAbstractionLayerFactory.h"
+#include "FlashTranslationLayer.h"
+#include "LfsFalBinding.h"
+#include "SimulatedFlashAbstractionLayer.h"
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Defines                                                                               */
+/*-----------------------------------------------------------------------------------------------*/
+#define FUZZ_BOOTS_DEFAULT       (40U)
+#define FUZZ_BOOT_INCREMENTS     (5U)        // boot_count updates per boot, as in main.cpp
+#define FUZZ_LOG_LINE            (96U)       // Bytes appended to txts/log.txt per boot
+#define FUZZ_DATA_SIZE           (3000U)     // Size of data.bin, rewritten every boot
+#define FUZZ_CHUNK               (256U)
+#define FUZZ_MAX_REPORTS         (16U)       // Failures printed before the rest are only counted
+#ifdef LFS_READ_CACHE
+#define FUZZ_READ_CACHES         (2U)        // lfs_config::read_cache_count, so recovery covers them
+#else
+#define FUZZ_READ_CACHES         (0U)
+#endif
+#define FUZZ_FETCH_CACHES        (2U)        // lfs_config::fetch_cache_count
+#ifdef LFS_DENTRY_CACHE
+#define FUZZ_DENTRY_CACHES       (8U)        // lfs_config::dentry_cache_count, more paths than a boot opens
+#define FUZZ_PATH_BYTES          (FUZZ_DENTRY_CACHES * LFS_DENTRY_PATH_MAX)
+#else
+#define FUZZ_PATH_BYTES          (0U)
+#endif
+#ifdef LFS_CTZ_CACHE
+#define FUZZ_POSITIONS           (4U)        // lfs_file_config::ctz_cache_count
+#endif
+
+static const char fuzz_text[] = "This is a text file in the txts directory!";
+
+typedef SimulatedFlashAbstractionLayer<FAL_FLASH_PART> SimulatedFlash;
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Types                                                                                 */
+/*-----------------------------------------------------------------------------------------------*/
+// What the files should hold, 0 stands for a file that does not exist yet
+struct FsState {
+  uint32_t bootCount;        // Value in boot_count
+  uint32_t textSize;         // Size of txts/myfile.txt
+  uint32_t logSize;          // Size of txts/log.txt
+  uint32_t generation;       // Boot that last wrote data.bin
+};
+
+// Everything one thread needs to mount and run the workload on its own flash image
+struct FuzzWorker {
+  SimulatedFlash flash;
+  FlashTranslationLayer<SimulatedFlash> *ftl;
+  struct lfs_config cfg;
+  lfs_t lfs;
+  lfs_file_t file;
+  struct lfs_file_config fileCfg;
+  uint8_t *buffers;          // read, prog, file cache, extra read caches, lookahead and paths in one allocation
+#ifdef LFS_CTZ_CACHE
+  struct lfs_ctzpos positions[FUZZ_POSITIONS];
+#endif
+  uint8_t chunk[FUZZ_CHUNK];
+  FsState committed;         // State known to be on flash
+  FsState pending;           // State if the operation in flight completes
+  uint32_t boot;
+};
+
+// Work shared by all threads
+struct FuzzJob {
+  const FlashGeometry *geometry;
+  const uint8_t *formatted;  // Region image right after formatting
+  uint32_t boots;
+  uint32_t stride;
+  uint32_t lastCut;
+  std::atomic<uint32_t> nextCut;
+  std::atomic<uint32_t> cuts;
+  std::atomic<uint32_t> failures;
+};
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Private Functions                                                                             */
+/*-----------------------------------------------------------------------------------------------*/
+/**
+ * @brief Expected byte of a generated file
+ */
+static uint8_t pattern(uint32_t generation, uint32_t offset) {
+  return (uint8_t)((offset * 31U + generation * 7U) ^ (offset >> 8));
+}
+
+/**
+ * @brief Set up the translation layer, LittleFS configuration and static buffers of a worker
+ */
+static bool worker_init(FuzzWorker *w, const FlashGeometry *geometry) {
+  w->ftl = new FlashTranslationLayer<SimulatedFlash>(&w->flash, geometry->sectorSize, geometry->sectorCount, geometry->blockSize);
+  memset(&w->cfg, 0, sizeof(w->cfg));
+  FlashAbstractionLayerFactory::tuneConfig(geometry, &w->cfg);
+  LfsFalBinding<FlashTranslationLayer<SimulatedFlash>>::bind(w->ftl, &w->cfg);
+  w->cfg.block_count = w->ftl->logicalBlockCount();
+  w->cfg.block_cycles = 500;
+
+#ifdef LFS_READ_CACHE
+  w->cfg.read_cache_count = FUZZ_READ_CACHES;
+#endif
+#ifdef LFS_FETCH_CACHE
+  w->cfg.fetch_cache_count = FUZZ_FETCH_CACHES;
+#endif
+#ifdef LFS_DENTRY_CACHE
+  w->cfg.dentry_cache_count = FUZZ_DENTRY_CACHES;
+#endif
+
+  // Buffers are never freed by LittleFS, so a mount abandoned at a power cut leaks nothing
+  w->buffers = (uint8_t *)malloc((3U + FUZZ_READ_CACHES) * w->cfg.cache_size + w->cfg.lookahead_size +
+                                 FUZZ_PATH_BYTES);
+  if (w->buffers == nullptr || w->flash.image() == nullptr) {
+    return false;
+  }
+  w->cfg.read_buffer = w->buffers;
+  w->cfg.prog_buffer = w->buffers + w->cfg.cache_size;
+#ifdef LFS_READ_CACHE
+  w->cfg.read_cache_buffer = w->buffers + 3U * w->cfg.cache_size;
+#endif
+  w->cfg.lookahead_buffer = w->buffers + (3U + FUZZ_READ_CACHES) * w->cfg.cache_size;
+#ifdef LFS_DENTRY_CACHE
+  w->cfg.dentry_cache_buffer = (uint8_t *)w->cfg.lookahead_buffer + w->cfg.lookahead_size;
+#endif
+  memset(&w->fileCfg, 0, sizeof(w->fileCfg));
+  w->fileCfg.buffer = w->buffers + 2U * w->cfg.cache_size;
+#ifdef LFS_CTZ_CACHE
+  w->fileCfg.ctz_cache_count = FUZZ_POSITIONS;
+  w->fileCfg.ctz_cache = w->positions;
+#endif
+  return true;
+}
+
+/**
+ * @brief Release a worker
+ */
+static void worker_free(FuzzWorker *w) {
+  delete w->ftl;
+  free(w->buffers);
+}
+
+/**
+ * @brief Mount the translation layer and LittleFS
+ */
+static int worker_mount(FuzzWorker *w) {
+  int err = w->ftl->mount();
+  return (err != 0) ? err : lfs_mount(&w->lfs, &w->cfg);
+}
+
+/**
+ * @brief Open the worker's file with its static cache
+ */
+static int open_file(FuzzWorker *w, const char *path, int flags) {
+  return lfs_file_opencfg(&w->lfs, &w->file, path, flags, &w->fileCfg);
+}
+
+/**
+ * @brief Write size bytes of a generated pattern starting at offset
+ */
+static int write_pattern(FuzzWorker *w, uint32_t generation, uint32_t offset, uint32_t size) {
+  for (uint32_t done = 0; done < size; done += FUZZ_CHUNK) {
+    uint32_t n = (size - done < FUZZ_CHUNK) ? size - done : FUZZ_CHUNK;
+    for (uint32_t i = 0; i < n; i++) {
+      w->chunk[i] = pattern(generation, offset + done + i);
+    }
+    lfs_ssize_t written = lfs_file_write(&w->lfs, &w->file, w->chunk, n);
+    if (written != (lfs_ssize_t)n) {
+      return (written < 0) ? (int)written : LFS_ERR_IO;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Run one boot of the workload, keeping committed and pending in step with the flash
+ * @return 0 on success, the LittleFS error of the operation that failed otherwise
+ */
+static int run_boot(FuzzWorker *w) {
+  int err;
+  w->boot++;
+
+  // Boot count, same sequence as main.cpp
+  w->pending.bootCount = w->committed.bootCount + FUZZ_BOOT_INCREMENTS;
+  err = open_file(w, "boot_count", LFS_O_RDWR | LFS_O_CREAT);
+  if (err != 0) {
+    return err;
+  }
+  uint32_t bootCount = 0;
+  for (uint32_t i = 0; i < FUZZ_BOOT_INCREMENTS; i++) {
+    lfs_file_read(&w->lfs, &w->file, &bootCount, sizeof(bootCount));
+    bootCount += 1U;
+    lfs_file_rewind(&w->lfs, &w->file);
+    lfs_file_write(&w->lfs, &w->file, &bootCount, sizeof(bootCount));
+  }
+  err = lfs_file_close(&w->lfs, &w->file);
+  if (err != 0) {
+    return err;
+  }
+  w->committed.bootCount = w->pending.bootCount;
+
+  err = lfs_mkdir(&w->lfs, "txts");
+  if (err != 0 && err != LFS_ERR_EXIST) {
+    return err;
+  }
+
+  // Text file, rewritten in place with the same content
+  w->pending.textSize = sizeof(fuzz_text) - 1U;
+  err = open_file(w, "txts/myfile.txt", LFS_O_RDWR | LFS_O_CREAT);
+  if (err != 0) {
+    return err;
+  }
+  lfs_ssize_t written = lfs_file_write(&w->lfs, &w->file, fuzz_text, sizeof(fuzz_text) - 1U);
+  err = lfs_file_close(&w->lfs, &w->file);
+  if (written < 0 || err != 0) {
+    return (written < 0) ? (int)written : err;
+  }
+  w->committed.textSize = w->pending.textSize;
+
+  // Log append, grows into a multi-block CTZ list
+  w->pending.logSize = w->committed.logSize + FUZZ_LOG_LINE;
+  err = open_file(w, "txts/log.txt", LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND);
+  if (err != 0) {
+    return err;
+  }
+  err = write_pattern(w, 0U, w->committed.logSize, FUZZ_LOG_LINE);
+  int closeErr = lfs_file_close(&w->lfs, &w->file);
+  if (err != 0 || closeErr != 0) {
+    return (err != 0) ? err : closeErr;
+  }
+  w->committed.logSize = w->pending.logSize;
+
+  // Whole-file rewrite, alternating truncate in place and write-then-rename
+  // The temporary name sorts first, so creating and renaming it shifts the ids of every other entry
+  w->pending.generation = w->boot;
+  bool rename = (w->boot & 1U) != 0U;
+  err = open_file(w, rename ? ".data.tmp" : "data.bin", LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+  if (err != 0) {
+    return err;
+  }
+  err = write_pattern(w, w->boot, 0U, FUZZ_DATA_SIZE);
+  closeErr = lfs_file_close(&w->lfs, &w->file);
+  if (err != 0 || closeErr != 0) {
+    return (err != 0) ? err : closeErr;
+  }
+  if (rename) {
+    err = lfs_rename(&w->lfs, ".data.tmp", "data.bin");
+    if (err != 0) {
+      return err;
+    }
+  }
+  w->committed.generation = w->pending.generation;
+  return 0;
+}
+
+/**
+ * @brief Compare a file against a generated pattern
+ * @return Size of the file, negative LittleFS error, or -1 on a mismatch
+ */
+static lfs_ssize_t read_pattern(FuzzWorker *w, const char *path, uint32_t generation, bool *match) {
+  *match = true;
+  int err = open_file(w, path, LFS_O_RDONLY);
+  if (err != 0) {
+    return err;
+  }
+  lfs_ssize_t total = 0;
+  for (;;) {
+    lfs_ssize_t n = lfs_file_read(&w->lfs, &w->file, w->chunk, FUZZ_CHUNK);
+    if (n <= 0) {
+      total = (n < 0) ? n : total;
+      break;
+    }
+    for (lfs_ssize_t i = 0; i < n; i++) {
+      *match = *match && w->chunk[i] == pattern(generation, (uint32_t)(total + i));
+    }
+    total += n;
+  }
+  lfs_file_close(&w->lfs, &w->file);
+  return total;
+}
+
+/**
+ * @brief Check that every file holds its committed or pending state, then adopt what was found
+ * @return nullptr if the filesystem is consistent, a description of the violation otherwise
+ */
+static const char *check_fs(FuzzWorker *w) {
+  FsState *c = &w->committed;
+  FsState *p = &w->pending;
+  struct lfs_info info;
+  bool match;
+
+  // boot_count holds one of the two counts, or is missing before the first boot finished
+  uint32_t bootCount = 0;
+  int err = open_file(w, "boot_count", LFS_O_RDONLY);
+  if (err == 0) {
+    lfs_ssize_t n = lfs_file_read(&w->lfs, &w->file, &bootCount, sizeof(bootCount));
+    lfs_file_close(&w->lfs, &w->file);
+    if (n != (lfs_ssize_t)sizeof(bootCount) && n != 0) {
+      return "boot_count has a torn size";
+    }
+  } else if (err != LFS_ERR_NOENT) {
+    return "boot_count cannot be opened";
+  }
+  if (bootCount != c->bootCount && bootCount != p->bootCount) {
+    return "boot_count lost a committed update";
+  }
+  c->bootCount = bootCount;
+
+  // Text file is empty right after creation, complete after its first close
+  lfs_ssize_t size = 0;
+  if (lfs_stat(&w->lfs, "txts/myfile.txt", &info) == 0) {
+    size = (lfs_ssize_t)info.size;
+    char text[sizeof(fuzz_text)];
+    if ((size != 0 && size != (lfs_ssize_t)sizeof(fuzz_text) - 1) || open_file(w, "txts/myfile.txt", LFS_O_RDONLY) != 0) {
+      return "txts/myfile.txt has a torn size";
+    }
+    lfs_ssize_t n = lfs_file_read(&w->lfs, &w->file, text, sizeof(text));
+    lfs_file_close(&w->lfs, &w->file);
+    if (n != size || memcmp(text, fuzz_text, (size_t)size) != 0) {
+      return "txts/myfile.txt is corrupt";
+    }
+  }
+  if ((uint32_t)size != c->textSize && (uint32_t)size != p->textSize) {
+    return "txts/myfile.txt lost a committed update";
+  }
+  c->textSize = (uint32_t)size;
+
+  // Log holds whole appends only
+  size = read_pattern(w, "txts/log.txt", 0U, &match);
+  size = (size == LFS_ERR_NOENT) ? 0 : size;
+  if (size < 0 || !match) {
+    return "txts/log.txt is corrupt";
+  }
+  if ((uint32_t)size != c->logSize && (uint32_t)size != p->logSize) {
+    return "txts/log.txt has a torn append";
+  }
+  c->logSize = (uint32_t)size;
+
+  // data.bin is one complete generation, never a mix
+  uint32_t generation = 0;
+  if (lfs_stat(&w->lfs, "data.bin", &info) == 0) {
+    generation = p->generation;
+    size = read_pattern(w, "data.bin", generation, &match);
+    if (size == FUZZ_DATA_SIZE && !match) {
+      generation = c->generation;
+      size = read_pattern(w, "data.bin", generation, &match);
+    }
+    if (size != FUZZ_DATA_SIZE || !match || generation == 0U) {
+      return "data.bin is torn or mixed";
+    }
+  }
+  if (generation != c->generation && generation != p->generation) {
+    return "data.bin lost a committed rewrite";
+  }
+  c->generation = generation;
+
+  // Every block reachable from the root must be readable
+  if (lfs_fs_size(&w->lfs) < 0) {
+    return "filesystem traversal failed";
+  }
+  *p = *c;
+  return nullptr;
+}
+
+/**
+ * @brief Run the workload with power lost at one operation, recover and check
+ * @return nullptr on success or when the workload ends before the cut, a description otherwise
+ */
+static const char *run_cut(FuzzWorker *w, const FuzzJob *job, uint32_t cut, bool *reached) {
+  memcpy(w->flash.image(), job->formatted, FAL_FLASH_PART::regionSize);
+  w->flash.powerOn();
+  memset(&w->committed, 0, sizeof(w->committed));
+  w->pending = w->committed;
+  w->boot = 0;
+  if (worker_mount(w) != 0) {
+    return "mount of the formatted image failed";
+  }
+
+  // Run until the cut hits, the filesystem is abandoned mid-operation like on a reset
+  w->flash.cutPowerAfter(cut, cut);
+  *reached = false;
+  for (uint32_t b = 0; b < job->boots && !*reached; b++) {
+    int err = run_boot(w);
+    *reached = w->flash.powerLost();
+    if (err != 0 && !*reached) {
+      return "workload failed without a power loss";
+    }
+  }
+  if (!*reached) {
+    return nullptr;
+  }
+
+  w->flash.powerOn();
+  if (w->ftl->mount() != 0) {
+    return "translation layer mount failed";
+  }
+  if (lfs_mount(&w->lfs, &w->cfg) != 0) {
+    return "LittleFS mount failed";
+  }
+  const char *failure = check_fs(w);
+  if (failure != nullptr) {
+    return failure;
+  }
+
+  // The recovered filesystem must take a full boot and survive a clean remount
+  if (run_boot(w) != 0) {
+    return "boot after recovery failed";
+  }
+  if (lfs_unmount(&w->lfs) != 0 || worker_mount(w) != 0) {
+    return "remount after recovery failed";
+  }
+  failure = check_fs(w);
+  lfs_unmount(&w->lfs);
+  if (failure == nullptr && w->flash.programConflicts() != 0U) {
+    failure = "a program tried to set bits without an erase";
+  }
+  return failure;
+}
+
+/**
+ * @brief Thread body, takes cut points until the workload no longer reaches them
+ */
+static void fuzz_thread(FuzzJob *job) {
+  FuzzWorker *w = new FuzzWorker();
+  if (!worker_init(w, job->geometry)) {
+    fprintf(stderr, "out of memory\n");
+    job->failures++;
+    worker_free(w);
+    delete w;
+    return;
+  }
+
+  for (;;) {
+    uint32_t cut = job->nextCut.fetch_add(job->stride);
+    if (cut > job->lastCut) {
+      break;
+    }
+    bool reached;
+    const char *failure = run_cut(w, job, cut, &reached);
+    job->cuts++;
+    if (failure != nullptr && job->failures++ < FUZZ_MAX_REPORTS) {
+      fprintf(stderr, "cut %lu (boot %lu): %s\n", (unsigned long)cut, (unsigned long)w->boot, failure);
+    }
+  }
+  worker_free(w);
+  delete w;
+}
+
+/**
+ * @brief Monotonic wall time in seconds
+ */
+static double wall_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/*-----------------------------------------------------------------------------------------------*/
+/* Main                                                                                          */
+/*-----------------------------------------------------------------------------------------------*/
+int main(int argc, char **argv) {
+  uint32_t stride = (argc > 1) ? (uint32_t)strtoul(argv[1], nullptr, 0) : 1U;
+  uint32_t threads = (argc > 2) ? (uint32_t)strtoul(argv[2], nullptr, 0) : 0U;
+  uint32_t boots = (argc > 3) ? (uint32_t)strtoul(argv[3], nullptr, 0) : FUZZ_BOOTS_DEFAULT;
+  uint32_t first = (argc > 4) ? (uint32_t)strtoul(argv[4], nullptr, 0) : 1U;
+  stride = (stride != 0U) ? stride : 1U;
+  first = (first != 0U) ? first : 1U;
+  threads = (threads != 0U) ? threads : std::thread::hardware_concurrency();
+  threads = (threads != 0U) ? threads : 1U;
+
+  FlashGeometry geometry;
+  delete FlashAbstractionLayerFactory::createFlashAbstractionLayer(&geometry);
+
+  // Format once, every cut starts from a copy of this image
+  FuzzWorker *w = new FuzzWorker();
+  static FuzzJob job;
+  if (!worker_init(w, &geometry) || w->ftl->format() != 0 || w->ftl->mount() != 0 ||
+      lfs_format(&w->lfs, &w->cfg) != 0) {
+    fprintf(stderr, "format failed, geometry not supported\n");
+    return 1;
+  }
+  uint8_t *formatted = (uint8_t *)malloc(FAL_FLASH_PART::regionSize);
+  memcpy(formatted, w->flash.image(), FAL_FLASH_PART::regionSize);
+
+  // Dry run without a cut: counts the operations and checks the workload against the model
+  job.geometry = &geometry;
+  job.formatted = formatted;
+  job.boots = boots;
+  bool reached;
+  uint32_t before = w->flash.operations();
+  const char *failure = run_cut(w, &job, 0U, &reached);
+  uint32_t operations = w->flash.operations() - before;
+  if (failure == nullptr) {
+    lfs_unmount(&w->lfs);
+    failure = (worker_mount(w) != 0) ? "remount failed" : check_fs(w);
+  }
+  if (failure != nullptr) {
+    fprintf(stderr, "workload without power loss: %s\n", failure);
+    return 1;
+  }
+  printf("%lu boots, %lu programs and erases, %lu blocks of %lu bytes, %lu threads\n", (unsigned long)boots,
+         (unsigned long)operations, (unsigned long)w->cfg.block_count, (unsigned long)w->cfg.block_size,
+         (unsigned long)threads);
+  worker_free(w);
+  delete w;
+
+  job.stride = stride;
+  job.lastCut = operations;
+  job.nextCut = first;
+  job.cuts = 0;
+  job.failures = 0;
+  double start = wall_seconds();
+  std::vector<std::thread> pool;
+  for (uint32_t t = 0; t < threads; t++) {
+    pool.emplace_back(fuzz_thread, &job);
+  }
+  for (std::thread &t : pool) {
+    t.join();
+  }
+  double seconds = wall_seconds() - start;
+
+  printf("%lu cut points in %.1f s (%.0f per minute), %lu failures\n", (unsigned long)job.cuts.load(), seconds,
+         (seconds > 0.0) ? (double)job.cuts.load() * 60.0 / seconds : 0.0, (unsigned long)job.failures.load());
+  free(formatted);
+  return (job.failures.load() == 0U) ? 0 : 1;
+}